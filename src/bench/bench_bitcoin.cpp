@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <bench/bench.h>
+#include <bench/pop_data.h>
 
 #include <util/strencodings.h>
 #include <util/system.h>
@@ -29,6 +30,9 @@ static void SetupBenchArgs()
     gArgs.AddArg("-plot-plotlyurl=<uri>", strprintf("URL to use for plotly.js (default: %s)", DEFAULT_PLOT_PLOTLYURL), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-plot-width=<x>", strprintf("Plot width in pixel (default: %u)", DEFAULT_PLOT_WIDTH), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-plot-height=<x>", strprintf("Plot height in pixel (default: %u)", DEFAULT_PLOT_HEIGHT), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-popvbkblocks=<n>", strprintf("Number of VBK blocks in generated PoP data (default: %u)", benchmark::pop::DEFAULT_BENCH_POP_VBK_BLOCKS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-popvtbs=<n>", strprintf("Number of VTBs in generated PoP data (default: %u)", benchmark::pop::DEFAULT_BENCH_POP_VTBS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-popatvs=<n>", strprintf("Number of ATVs in generated PoP data (default: %u)", benchmark::pop::DEFAULT_BENCH_POP_ATVS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 }
 
 int main(int argc, char** argv)
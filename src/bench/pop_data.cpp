@@ -0,0 +1,81 @@
+// Copyright (c) 2019-2020 Xenios SEZC
+// https://www.veriblock.org
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/pop_data.h>
+
+#include <chain.h>
+#include <crypto/common.h>
+#include <streams.h>
+#include <util/system.h>
+#include <validation.h>
+#include <vbk/pop_service.hpp>
+#include <version.h>
+
+#include <algorithm>
+#include <cassert>
+
+namespace benchmark {
+namespace pop {
+
+PopDataSize GetPopDataSize()
+{
+    PopDataSize size;
+    size.vbk_blocks = (size_t)std::max<int64_t>(0, gArgs.GetArg("-popvbkblocks", DEFAULT_BENCH_POP_VBK_BLOCKS));
+    size.vtbs = (size_t)std::max<int64_t>(0, gArgs.GetArg("-popvtbs", DEFAULT_BENCH_POP_VTBS));
+    size.atvs = (size_t)std::max<int64_t>(0, gArgs.GetArg("-popatvs", DEFAULT_BENCH_POP_ATVS));
+    return size;
+}
+
+static altintegration::PublicationData CreatePublicationData(const CBlockIndex& endorsed, uint32_t payout)
+{
+    altintegration::PublicationData pub;
+    pub.identifier = VeriBlock::GetPop().config->alt->getIdentifier();
+    pub.payoutInfo.resize(sizeof(payout));
+    WriteLE32(pub.payoutInfo.data(), payout);
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << endorsed.GetBlockHeader();
+    pub.header = std::vector<uint8_t>{stream.begin(), stream.end()};
+    return pub;
+}
+
+altintegration::PopData PopDataGenerator::Generate(const PopDataSize& size, const CBlockIndex* endorsed)
+{
+    altintegration::PopData popData;
+
+    for (size_t i = 0; i < size.vbk_blocks; ++i) {
+        popData.context.push_back(m_popminer.mineVbkBlocks(1)->getHeader());
+    }
+
+    auto lastKnownBtc = VeriBlock::getLastKnownBTCBlocks(1)[0];
+    for (size_t i = 0; i < size.vtbs; ++i) {
+        auto* vbkendorsed = m_popminer.vbk().getBestChain().tip();
+        auto btctx = m_popminer.createBtcTxEndorsingVbkBlock(vbkendorsed->getHeader());
+        auto* btccontaining = m_popminer.mineBtcBlocks(1);
+        m_popminer.createVbkPopTxEndorsingVbkBlock(btccontaining->getHeader(), btctx, vbkendorsed->getHeader(), lastKnownBtc);
+        auto* vbkcontaining = m_popminer.mineVbkBlocks(1);
+        auto& vtbs = m_popminer.vbkPayloads[vbkcontaining->getHash()];
+        popData.vtbs.insert(popData.vtbs.end(), vtbs.begin(), vtbs.end());
+    }
+
+    assert(size.atvs == 0 || endorsed != nullptr);
+    for (size_t i = 0; i < size.atvs; ++i) {
+        altintegration::ValidationState state;
+        auto vbktx = m_popminer.createVbkTxEndorsingAltBlock(CreatePublicationData(*endorsed, m_payout++));
+        popData.atvs.push_back(m_popminer.applyATV(vbktx, state));
+        assert(state.IsValid());
+    }
+
+    return popData;
+}
+
+void SubmitPopData(const altintegration::PopData& popData)
+{
+    LOCK2(cs_main, VeriBlock::cs_popmempool);
+    VeriBlock::GetPop().mempool->submitAll(popData);
+}
+
+} // namespace pop
+} // namespace benchmark
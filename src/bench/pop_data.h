@@ -0,0 +1,60 @@
+// Copyright (c) 2019-2020 Xenios SEZC
+// https://www.veriblock.org
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BENCH_POP_DATA_H
+#define BITCOIN_BENCH_POP_DATA_H
+
+#include <veriblock/mock_miner.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+class CBlockIndex;
+
+namespace benchmark {
+namespace pop {
+
+static const size_t DEFAULT_BENCH_POP_VBK_BLOCKS = 20;
+static const size_t DEFAULT_BENCH_POP_VTBS = 20;
+static const size_t DEFAULT_BENCH_POP_ATVS = 10;
+
+//! Number of payloads of each type in generated PopData
+struct PopDataSize {
+    size_t vbk_blocks;
+    size_t vtbs;
+    size_t atvs;
+};
+
+//! Sizes set with -popvbkblocks, -popvtbs and -popatvs
+PopDataSize GetPopDataSize();
+
+/**
+ * Deterministic generator of PoP payloads. Blocks and transactions are mined
+ * by a MockMiner, which starts from the same bootstrap blocks as regtest, so
+ * the same sequence of calls always yields the same payloads.
+ */
+class PopDataGenerator
+{
+public:
+    /**
+     * Mine size.vbk_blocks VBK blocks, then size.vtbs VTBs, each endorsing
+     * the VBK tip, then size.atvs ATVs endorsing `endorsed`. Payloads connect
+     * to the ones from previous calls.
+     */
+    altintegration::PopData Generate(const PopDataSize& size, const CBlockIndex* endorsed = nullptr);
+
+private:
+    altintegration::MockMiner m_popminer;
+    //! makes payout info, and so ATVs, unique
+    uint32_t m_payout{0};
+};
+
+//! Add payloads into PoP mempool, so they are mined into the next block
+void SubmitPopData(const altintegration::PopData& popData);
+
+} // namespace pop
+} // namespace benchmark
+
+#endif // BITCOIN_BENCH_POP_DATA_H
@@ -0,0 +1,63 @@
+// Copyright (c) 2019-2020 Xenios SEZC
+// https://www.veriblock.org
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chainparams.h>
+#include <script/script.h>
+#include <test/util/mining.h>
+#include <validation.h>
+#include <vbk/pop_service.hpp>
+
+static const CScript SCRIPT_PUB{CScript() << OP_TRUE};
+
+static void MinePastSettlementInterval()
+{
+    const int blocks = (int)VeriBlock::GetPop().config->alt->getEndorsementSettlementInterval() + 10;
+    for (int i = 0; i < blocks; ++i) {
+        MineBlock(SCRIPT_PUB);
+    }
+}
+
+// Block template creation and TestBlockValidity compute rewards for the same
+// parent three times: for the coinbase, in ConnectBlock and in
+// checkCoinbaseTxWithPopRewards.
+static void ConnectBlockPopRewards(benchmark::State& state, bool cached)
+{
+    MinePastSettlementInterval();
+
+    while (state.KeepRunning()) {
+        if (!cached) {
+            LOCK(cs_main);
+            VeriBlock::onPopStateChanged();
+        }
+        PrepareBlock(SCRIPT_PUB);
+    }
+}
+
+static void ConnectBlockPopRewardsCached(benchmark::State& state)
+{
+    ConnectBlockPopRewards(state, true);
+}
+
+static void ConnectBlockPopRewardsUncached(benchmark::State& state)
+{
+    ConnectBlockPopRewards(state, false);
+}
+
+static void CalculatePopRewards(benchmark::State& state)
+{
+    MinePastSettlementInterval();
+
+    LOCK(cs_main);
+    const CBlockIndex& tip = *::ChainActive().Tip();
+    while (state.KeepRunning()) {
+        VeriBlock::onPopStateChanged();
+        VeriBlock::getPopRewards(tip, Params().GetConsensus());
+    }
+}
+
+BENCHMARK(ConnectBlockPopRewardsCached, 50);
+BENCHMARK(ConnectBlockPopRewardsUncached, 50);
+BENCHMARK(CalculatePopRewards, 1000);
@@ -0,0 +1,266 @@
+// Copyright (c) 2019-2020 Xenios SEZC
+// https://www.veriblock.org
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <bench/pop_data.h>
+#include <chainparams.h>
+#include <consensus/validation.h>
+#include <net.h>
+#include <script/script.h>
+#include <streams.h>
+#include <test/util/mining.h>
+#include <txdb.h>
+#include <validation.h>
+#include <vbk/merkle.hpp>
+#include <vbk/p2p_sync.hpp>
+#include <vbk/pop_service.hpp>
+#include <vbk/vbk.hpp>
+#include <version.h>
+
+#include <deque>
+#include <vector>
+
+using benchmark::pop::GetPopDataSize;
+using benchmark::pop::PopDataGenerator;
+using benchmark::pop::PopDataSize;
+using benchmark::pop::SubmitPopData;
+
+static const CScript SCRIPT_PUB{CScript() << OP_TRUE};
+//! blocks of competing forks must differ from the main chain ones mined at the same time
+static const CScript SCRIPT_PUB_FORK{CScript() << OP_2};
+static const int ENDORSED_BLOCKS = 10;
+
+static CBlockIndex* Tip()
+{
+    LOCK(cs_main);
+    return ::ChainActive().Tip();
+}
+
+//! Mine `count` blocks, each containing payloads which endorse its parent
+static void MineEndorsedBlocks(PopDataGenerator& generator, const PopDataSize& size, int count, const CScript& script = SCRIPT_PUB)
+{
+    for (int i = 0; i < count; ++i) {
+        SubmitPopData(generator.Generate(size, Tip()));
+        MineBlock(script);
+    }
+}
+
+//! Block with payloads, which extends the active chain
+static std::shared_ptr<CBlock> PrepareEndorsedBlock(PopDataGenerator& generator, const PopDataSize& size)
+{
+    SubmitPopData(generator.Generate(size, Tip()));
+    auto block = PrepareBlock(SCRIPT_PUB);
+    assert(block->nVersion & VeriBlock::POP_BLOCK_VERSION_BIT);
+    return block;
+}
+
+static void AddAllBlockPayloads(benchmark::State& state)
+{
+    PopDataGenerator generator;
+    auto block = PrepareEndorsedBlock(generator, GetPopDataSize());
+
+    // every iteration adds the same payloads into a new sibling block
+    std::deque<uint256> hashes;
+    std::deque<CBlockIndex> indices;
+    LOCK(cs_main);
+    CBlockIndex* tip = ::ChainActive().Tip();
+    while (state.KeepRunning()) {
+        // stateless checks are cached in payloads
+        for (auto& vtb : block->popData.vtbs) {
+            vtb.checked = false;
+        }
+        ++block->nNonce;
+        hashes.push_back(block->GetHash());
+        indices.emplace_back(block->GetBlockHeader());
+        CBlockIndex& index = indices.back();
+        index.phashBlock = &hashes.back();
+        index.pprev = tip;
+        index.nHeight = tip->nHeight + 1;
+
+        BlockValidationState vstate;
+        bool ret = VeriBlock::acceptBlock(index, vstate) && VeriBlock::addAllBlockPayloads(*block, vstate);
+        assert(ret);
+    }
+}
+
+static void CompareForks(benchmark::State& state)
+{
+    PopDataGenerator generator;
+    const PopDataSize size = GetPopDataSize();
+
+    const CBlockIndex* fork_point = Tip();
+    for (int i = 0; i < ENDORSED_BLOCKS; ++i) {
+        MineBlock(SCRIPT_PUB);
+    }
+    CBlockIndex* left = Tip();
+    CBlockIndex* left_first = left->GetAncestor(fork_point->nHeight + 1);
+
+    // mine an endorsed fork next to the left one
+    BlockValidationState vstate;
+    InvalidateBlock(vstate, Params(), left_first);
+    MineEndorsedBlocks(generator, size, ENDORSED_BLOCKS, SCRIPT_PUB_FORK);
+    const CBlockIndex* right = Tip();
+    {
+        LOCK(cs_main);
+        ResetBlockFailureFlags(left_first);
+    }
+    ActivateBestChain(vstate, Params());
+
+    LOCK(cs_main);
+    while (state.KeepRunning()) {
+        // comparisons are memoized
+        VeriBlock::onPopStateChanged();
+        VeriBlock::compareForks(*left, *right);
+    }
+}
+
+static void CalculateEndorsedPopRewards(benchmark::State& state)
+{
+    PopDataGenerator generator;
+    const PopDataSize size = GetPopDataSize();
+
+    // move the endorsed blocks to the settlement height of the next block
+    MineEndorsedBlocks(generator, size, ENDORSED_BLOCKS);
+    const int blocks = (int)VeriBlock::GetPop().config->alt->getEndorsementSettlementInterval() - ENDORSED_BLOCKS - 1;
+    for (int i = 0; i < blocks; ++i) {
+        MineBlock(SCRIPT_PUB);
+    }
+
+    LOCK(cs_main);
+    const CBlockIndex& tip = *::ChainActive().Tip();
+    while (state.KeepRunning()) {
+        VeriBlock::onPopStateChanged();
+        VeriBlock::getPopRewards(tip, Params().GetConsensus());
+    }
+}
+
+static void PopMerkleRoots(benchmark::State& state)
+{
+    PopDataGenerator generator;
+    auto block = PrepareEndorsedBlock(generator, GetPopDataSize());
+
+    LOCK(cs_main);
+    const CBlockIndex* tip = ::ChainActive().Tip();
+    while (state.KeepRunning()) {
+        BlockValidationState vstate;
+        VeriBlock::BlockPopDataMerkleRoot(*block);
+        bool ret = VeriBlock::VerifyTopLevelMerkleRoot(*block, vstate, tip);
+        assert(ret);
+    }
+}
+
+// FlushStateToDisk writes only blocks changed since the previous flush, so
+// this is the cost of a flush which finds nothing to write.
+static void SavePopTreesUnchanged(benchmark::State& state)
+{
+    PopDataGenerator generator;
+    MineEndorsedBlocks(generator, GetPopDataSize(), ENDORSED_BLOCKS);
+    ::ChainstateActive().ForceFlushStateToDisk();
+
+    LOCK(cs_main);
+    while (state.KeepRunning()) {
+        CDBBatch batch(*pblocktree);
+        VeriBlock::saveTrees(batch);
+    }
+}
+
+static void LoadPopTrees(benchmark::State& state)
+{
+    PopDataGenerator generator;
+    MineEndorsedBlocks(generator, GetPopDataSize(), ENDORSED_BLOCKS);
+    ::ChainstateActive().ForceFlushStateToDisk();
+
+    LOCK(cs_main);
+    while (state.KeepRunning()) {
+        VeriBlock::SetPop(*pblocktree);
+        bool ret = VeriBlock::loadTrees(*pblocktree);
+        assert(ret);
+    }
+}
+
+template <typename pop_t>
+static void ProcessPopDataMessages(CNode& node, const std::vector<pop_t>& payloads)
+{
+    for (const auto& payload : payloads) {
+        CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+        stream << payload;
+        int ret = VeriBlock::p2p::processPopData(&node, pop_t::name(), stream, nullptr);
+        assert(ret == 1);
+    }
+}
+
+template <typename pop_t>
+static void RequestPopData(VeriBlock::p2p::PopDataNodeState& node_state, const std::vector<pop_t>& payloads)
+{
+    for (const auto& payload : payloads) {
+        node_state.filterRequested.insert(payload.getId().asVector());
+    }
+}
+
+// Payloads are relayed by a peer and then mined, which drops them from the
+// mempool and from per-peer state.
+static void ProcessPopData(benchmark::State& state)
+{
+    PopDataGenerator generator;
+    const auto popData = generator.Generate(GetPopDataSize(), Tip());
+
+    CAddress addr(CService(), NODE_NONE);
+    CNode node(0, ServiceFlags(NODE_NETWORK | NODE_WITNESS), 0, INVALID_SOCKET, addr, 0, 0, CAddress(), "", /*fInboundIn=*/false);
+    while (state.KeepRunning()) {
+        {
+            LOCK(VeriBlock::cs_popmempool);
+            auto& node_state = VeriBlock::p2p::getPopDataNodeState(node.GetId());
+            RequestPopData(node_state, popData.context);
+            RequestPopData(node_state, popData.vtbs);
+            RequestPopData(node_state, popData.atvs);
+        }
+
+        ProcessPopDataMessages(node, popData.context);
+        ProcessPopDataMessages(node, popData.vtbs);
+        ProcessPopDataMessages(node, popData.atvs);
+
+        LOCK(cs_main);
+        VeriBlock::removePayloadsFromMempool(popData);
+    }
+    VeriBlock::p2p::erasePopDataNodeState(node.GetId());
+}
+
+// Payloads of ENDORSED_BLOCKS blocks are disconnected tip first, as
+// DisconnectTip does, and the new chain contains the newer half of them
+// again. The older half, which connects to the PoP trees, is resubmitted into
+// PoP mempool and then mined to start over.
+static void ResubmitPopDataAfterReorg(benchmark::State& state)
+{
+    PopDataGenerator generator;
+    const PopDataSize size = GetPopDataSize();
+    std::vector<altintegration::PopData> disconnected;
+    for (int i = 0; i < ENDORSED_BLOCKS; ++i) {
+        disconnected.push_back(generator.Generate(size, Tip()));
+    }
+
+    LOCK(cs_main);
+    while (state.KeepRunning()) {
+        for (auto it = disconnected.rbegin(); it != disconnected.rend(); ++it) {
+            VeriBlock::addDisconnectedPopdata(*it);
+        }
+        for (int i = ENDORSED_BLOCKS / 2; i < ENDORSED_BLOCKS; ++i) {
+            VeriBlock::removePayloadsFromMempool(disconnected[i]);
+        }
+        VeriBlock::updatePopMempoolForReorg();
+
+        for (int i = 0; i < ENDORSED_BLOCKS / 2; ++i) {
+            VeriBlock::removePayloadsFromMempool(disconnected[i]);
+        }
+    }
+}
+
+BENCHMARK(AddAllBlockPayloads, 5);
+BENCHMARK(CompareForks, 50);
+BENCHMARK(CalculateEndorsedPopRewards, 50);
+BENCHMARK(PopMerkleRoots, 1000);
+BENCHMARK(SavePopTreesUnchanged, 50);
+BENCHMARK(LoadPopTrees, 5);
+BENCHMARK(ProcessPopData, 5);
+BENCHMARK(ResubmitPopDataAfterReorg, 5);
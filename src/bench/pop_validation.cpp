@@ -0,0 +1,59 @@
+// Copyright (c) 2019-2020 Xenios SEZC
+// https://www.veriblock.org
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <bench/pop_data.h>
+#include <util/system.h>
+#include <vbk/pop_service.hpp>
+
+#include <boost/thread/thread.hpp>
+
+static const size_t VTBS_PER_BLOCK = 200;
+static const int MIN_CORES = 2;
+
+static altintegration::PopData CreateHeavyPopData()
+{
+    benchmark::pop::PopDataGenerator generator;
+    return generator.Generate({0, VTBS_PER_BLOCK, 0});
+}
+
+static void ValidatePopData(benchmark::State& state, altintegration::PopData& popData)
+{
+    while (state.KeepRunning()) {
+        // stateless checks are cached in payloads
+        for (auto& vtb : popData.vtbs) {
+            vtb.checked = false;
+        }
+        altintegration::ValidationState vstate;
+        bool ret = VeriBlock::popdataStatelessValidation(popData, vstate);
+        assert(ret);
+    }
+}
+
+static void PopStatelessValidationSequential(benchmark::State& state)
+{
+    auto popData = CreateHeavyPopData();
+    ValidatePopData(state, popData);
+}
+
+static void PopStatelessValidationParallel(benchmark::State& state)
+{
+    auto popData = CreateHeavyPopData();
+
+    boost::thread_group tg;
+    for (int i = 0; i < std::max(MIN_CORES, GetNumCores()) - 1; ++i) {
+        tg.create_thread([i]() { return VeriBlock::ThreadPopCheck(i); });
+    }
+    VeriBlock::g_parallel_pop_checks = true;
+
+    ValidatePopData(state, popData);
+
+    VeriBlock::g_parallel_pop_checks = false;
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+BENCHMARK(PopStatelessValidationSequential, 5);
+BENCHMARK(PopStatelessValidationParallel, 5);
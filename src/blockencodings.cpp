@@ -15,9 +15,26 @@
 #include <txmempool.h>
 #include <validation.h>
 #include <util/system.h>
+#include <vbk/pop_common.hpp>
 
 #include <unordered_map>
 
+static uint64_t GetPopShortID(uint64_t k0, uint64_t k1, const std::vector<uint8_t>& id)
+{
+    return CSipHasher(k0, k1).Write(id.data(), id.size()).Finalize();
+}
+
+template <typename pop_t>
+static std::vector<uint64_t> GetPopShortIDs(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<pop_t>& payloads)
+{
+    std::vector<uint64_t> ret;
+    ret.reserve(payloads.size());
+    for (const auto& p : payloads) {
+        ret.push_back(cmpctblock.GetPopShortID(p.getId().asVector()));
+    }
+    return ret;
+}
+
 CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(const CBlock& block, bool fUseWTXID) :
         nonce(GetRand(std::numeric_limits<uint64_t>::max())),
         shorttxids(block.vtx.size() - 1), prefilledtxn(1), header(block) {
@@ -30,6 +47,9 @@ CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(const CBlock& block, bool f
     }
     // VeriBlock
     this->popData = block.popData;
+    shortvbkids = GetPopShortIDs(*this, block.popData.context);
+    shortvtbids = GetPopShortIDs(*this, block.popData.vtbs);
+    shortatvids = GetPopShortIDs(*this, block.popData.atvs);
 }
 
 void CBlockHeaderAndShortTxIDs::FillShortTxIDSelector() const {
@@ -48,6 +68,78 @@ uint64_t CBlockHeaderAndShortTxIDs::GetShortID(const uint256& txhash) const {
     return SipHashUint256(shorttxidk0, shorttxidk1, txhash) & 0xffffffffffffL;
 }
 
+uint64_t CBlockHeaderAndShortTxIDs::GetPopShortID(const std::vector<uint8_t>& id) const {
+    return ::GetPopShortID(shorttxidk0, shorttxidk1, id);
+}
+
+// Fill payloads of one type from PoP mempool. Like transactions, payloads
+// whose short id matches more than one mempool entry are requested.
+template <typename pop_t>
+static ReadStatus InitPopPayloads(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<uint64_t>& shortids, std::vector<pop_t>& payloads, std::vector<bool>& available, size_t& mempool_count) EXCLUSIVE_LOCKS_REQUIRED(VeriBlock::cs_popmempool)
+{
+    if (shortids.size() > std::numeric_limits<uint16_t>::max())
+        return READ_STATUS_INVALID;
+
+    payloads.assign(shortids.size(), pop_t{});
+    available.assign(shortids.size(), false);
+
+    std::unordered_map<uint64_t, uint16_t> positions(shortids.size());
+    for (size_t i = 0; i < shortids.size(); i++) {
+        positions[shortids[i]] = i;
+    }
+    if (positions.size() != shortids.size())
+        return READ_STATUS_FAILED; // Short ID collision
+
+    auto& pop_mempool = *VeriBlock::GetPop().mempool;
+    std::vector<bool> have(shortids.size());
+    size_t count = 0;
+    for (const auto& el : pop_mempool.getMap<pop_t>()) {
+        auto it = positions.find(cmpctblock.GetPopShortID(el.first.asVector()));
+        if (it != positions.end()) {
+            if (!have[it->second]) {
+                const pop_t* payload = pop_mempool.get<pop_t>(el.first);
+                if (payload == nullptr) continue;
+                payloads[it->second] = *payload;
+                available[it->second] = true;
+                have[it->second] = true;
+                count++;
+            } else if (available[it->second]) {
+                available[it->second] = false;
+                count--;
+            }
+        }
+        if (count == shortids.size())
+            break;
+    }
+    mempool_count += count;
+    return READ_STATUS_OK;
+}
+
+// Put payloads received in blocktxn into the slots which PoP mempool did not fill
+template <typename pop_t>
+static bool FillPopPayloads(uint64_t k0, uint64_t k1, const std::vector<uint64_t>& shortids, std::vector<pop_t>& payloads, const std::vector<bool>& available, const std::vector<pop_t>& missing)
+{
+    size_t missing_offset = 0;
+    for (size_t i = 0; i < payloads.size(); i++) {
+        if (available[i]) continue;
+        if (missing.size() <= missing_offset)
+            return false;
+        const pop_t& payload = missing[missing_offset++];
+        if (GetPopShortID(k0, k1, payload.getId().asVector()) != shortids[i])
+            return false;
+        payloads[i] = payload;
+    }
+    return missing.size() == missing_offset;
+}
+
+static void GetMissingPopPayloads(const std::vector<bool>& available, std::vector<uint16_t>& indexes)
+{
+    for (size_t i = 0; i < available.size(); i++) {
+        if (!available[i])
+            indexes.push_back(i);
+    }
+}
+
 
 
 ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn) {
@@ -168,7 +260,25 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
     }
 
     // VeriBlock: set pop data
-    this->popData = cmpctblock.popData;
+    fPopShortIDs = cmpctblock.fPopShortIDs;
+    if (fPopShortIDs) {
+        popshortidk0 = cmpctblock.shorttxidk0;
+        popshortidk1 = cmpctblock.shorttxidk1;
+        shortvbkids = cmpctblock.shortvbkids;
+        shortvtbids = cmpctblock.shortvtbids;
+        shortatvids = cmpctblock.shortatvids;
+
+        LOCK(VeriBlock::cs_popmempool);
+        ReadStatus status = InitPopPayloads(cmpctblock, shortvbkids, this->popData.context, vbk_available, pop_mempool_count);
+        if (status == READ_STATUS_OK)
+            status = InitPopPayloads(cmpctblock, shortvtbids, this->popData.vtbs, vtb_available, pop_mempool_count);
+        if (status == READ_STATUS_OK)
+            status = InitPopPayloads(cmpctblock, shortatvids, this->popData.atvs, atv_available, pop_mempool_count);
+        if (status != READ_STATUS_OK)
+            return status;
+    } else {
+        this->popData = cmpctblock.popData;
+    }
 
     LogPrint(BCLog::CMPCTBLOCK, "Initialized PartiallyDownloadedBlock for block %s using a cmpctblock of size %lu with %d VBK %d VTB %d ATV\n", cmpctblock.header.GetHash().ToString(), GetSerializeSize(cmpctblock, PROTOCOL_VERSION), this->popData.context.size(), this->popData.vtbs.size(), this->popData.atvs.size());
 
@@ -181,13 +291,18 @@ bool PartiallyDownloadedBlock::IsTxAvailable(size_t index) const {
     return txn_available[index] != nullptr;
 }
 
-ReadStatus PartiallyDownloadedBlock::FillBlock(CBlock& block, const std::vector<CTransactionRef>& vtx_missing, const altintegration::PopData& popData) {
-    block.popData = popData;
-    ReadStatus status = FillBlock(block, vtx_missing);
-    return status;
+void PartiallyDownloadedBlock::GetMissingPopData(BlockTransactionsRequest& req) const {
+    assert(!header.IsNull());
+    GetMissingPopPayloads(vbk_available, req.vbk_indexes);
+    GetMissingPopPayloads(vtb_available, req.vtb_indexes);
+    GetMissingPopPayloads(atv_available, req.atv_indexes);
 }
 
 ReadStatus PartiallyDownloadedBlock::FillBlock(CBlock& block, const std::vector<CTransactionRef>& vtx_missing) {
+    return FillBlock(block, vtx_missing, altintegration::PopData{});
+}
+
+ReadStatus PartiallyDownloadedBlock::FillBlock(CBlock& block, const std::vector<CTransactionRef>& vtx_missing, const altintegration::PopData& pop_missing) {
     assert(!header.IsNull());
     uint256 hash = header.GetHash();
     block = header;
@@ -211,7 +326,13 @@ ReadStatus PartiallyDownloadedBlock::FillBlock(CBlock& block, const std::vector<
         return READ_STATUS_INVALID;
 
     // VeriBlock: set popData before CheckBlock
-    block.popData = this->popData;
+    if (fPopShortIDs) {
+        if (!FillPopPayloads(popshortidk0, popshortidk1, shortvbkids, this->popData.context, vbk_available, pop_missing.context) ||
+            !FillPopPayloads(popshortidk0, popshortidk1, shortvtbids, this->popData.vtbs, vtb_available, pop_missing.vtbs) ||
+            !FillPopPayloads(popshortidk0, popshortidk1, shortatvids, this->popData.atvs, atv_available, pop_missing.atvs))
+            return READ_STATUS_INVALID;
+    }
+    block.popData = std::move(this->popData);
 
     BlockValidationState state;
     if (!CheckBlock(block, state, Params().GetConsensus())) {
@@ -224,7 +345,7 @@ ReadStatus PartiallyDownloadedBlock::FillBlock(CBlock& block, const std::vector<
         return READ_STATUS_CHECKBLOCK_FAILED;
     }
 
-    LogPrint(BCLog::CMPCTBLOCK, "Successfully reconstructed block %s with %lu txn prefilled, %lu txn from mempool (incl at least %lu from extra pool) and %lu txn requested, and %d VBK %d VTB %d ATV\n", hash.ToString(), prefilled_count, mempool_count, extra_count, vtx_missing.size(), this->popData.context.size(), this->popData.vtbs.size(), this->popData.atvs.size());
+    LogPrint(BCLog::CMPCTBLOCK, "Successfully reconstructed block %s with %lu txn prefilled, %lu txn from mempool (incl at least %lu from extra pool) and %lu txn requested, and %d VBK %d VTB %d ATV (%lu from PoP mempool)\n", hash.ToString(), prefilled_count, mempool_count, extra_count, vtx_missing.size(), block.popData.context.size(), block.popData.vtbs.size(), block.popData.atvs.size(), pop_mempool_count);
     if (vtx_missing.size() < 5) {
         for (const auto& tx : vtx_missing) {
             LogPrint(BCLog::CMPCTBLOCK, "Reconstructed block %s required tx %s\n", hash.ToString(), tx->GetHash().ToString());
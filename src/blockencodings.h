@@ -6,6 +6,7 @@
 #define BITCOIN_BLOCKENCODINGS_H
 
 #include <primitives/block.h>
+#include <version.h>
 
 
 class CTxMemPool;
@@ -30,6 +31,12 @@ public:
     // A BlockTransactionsRequest message
     uint256 blockhash;
     std::vector<uint16_t> indexes;
+    // VeriBlock: positions of missing payloads in block PoP data
+    std::vector<uint16_t> vbk_indexes;
+    std::vector<uint16_t> vtb_indexes;
+    std::vector<uint16_t> atv_indexes;
+
+    bool HasPopIndexes() const { return !vbk_indexes.empty() || !vtb_indexes.empty() || !atv_indexes.empty(); }
 
     ADD_SERIALIZE_METHODS;
 
@@ -64,6 +71,12 @@ public:
                 READWRITE(COMPACTSIZE(index));
             }
         }
+
+        if (s.GetVersion() >= POP_SHORT_IDS_VERSION) {
+            READWRITE(vbk_indexes);
+            READWRITE(vtb_indexes);
+            READWRITE(atv_indexes);
+        }
     }
 };
 
@@ -72,7 +85,8 @@ public:
     // A BlockTransactions message
     uint256 blockhash;
     std::vector<CTransactionRef> txn;
-    // VeriBlock data
+    // VeriBlock data. Since POP_SHORT_IDS_VERSION only the requested
+    // payloads, in the order of request indexes.
     altintegration::PopData popData;
 
     BlockTransactions() {}
@@ -145,6 +159,12 @@ protected:
     std::vector<uint64_t> shorttxids;
     std::vector<PrefilledTransaction> prefilledtxn;
 
+    // VeriBlock: short ids of payloads, sent instead of PoP data since POP_SHORT_IDS_VERSION
+    std::vector<uint64_t> shortvbkids;
+    std::vector<uint64_t> shortvtbids;
+    std::vector<uint64_t> shortatvids;
+    bool fPopShortIDs = false;
+
 public:
     CBlockHeader header;
     // VeriBlock data
@@ -157,6 +177,8 @@ public:
 
     uint64_t GetShortID(const uint256& txhash) const;
 
+    uint64_t GetPopShortID(const std::vector<uint8_t>& id) const;
+
     size_t BlockTxCount() const { return shorttxids.size() + prefilledtxn.size(); }
 
     ADD_SERIALIZE_METHODS;
@@ -190,7 +212,16 @@ public:
         }
 
         if (this->header.nVersion & VeriBlock::POP_BLOCK_VERSION_BIT) {
-            READWRITE(popData);
+            if (s.GetVersion() >= POP_SHORT_IDS_VERSION) {
+                READWRITE(shortvbkids);
+                READWRITE(shortvtbids);
+                READWRITE(shortatvids);
+                if (ser_action.ForRead()) {
+                    fPopShortIDs = true;
+                }
+            } else {
+                READWRITE(popData);
+            }
         }
 
         READWRITE(prefilledtxn);
@@ -208,6 +239,14 @@ protected:
     std::vector<CTransactionRef> txn_available;
     size_t prefilled_count = 0, mempool_count = 0, extra_count = 0;
     CTxMemPool* pool;
+
+    // VeriBlock: payloads which are not in popData yet, when built from short ids
+    bool fPopShortIDs = false;
+    uint64_t popshortidk0 = 0, popshortidk1 = 0;
+    std::vector<uint64_t> shortvbkids, shortvtbids, shortatvids;
+    std::vector<bool> vbk_available, vtb_available, atv_available;
+    size_t pop_mempool_count = 0;
+
 public:
     CBlockHeader header;
     altintegration::PopData popData;
@@ -216,6 +255,8 @@ public:
     // extra_txn is a list of extra transactions to look at, in <witness hash, reference> form
     ReadStatus InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn);
     bool IsTxAvailable(size_t index) const;
+    // VeriBlock: add positions of payloads missing from PoP mempool to the request
+    void GetMissingPopData(BlockTransactionsRequest& req) const;
     ReadStatus FillBlock(CBlock& block, const std::vector<CTransactionRef>& vtx_missing);
     ReadStatus FillBlock(CBlock& block, const std::vector<CTransactionRef>& vtx_missing, const altintegration::PopData& popData);
 };
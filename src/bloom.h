@@ -124,6 +124,9 @@ public:
 
     void reset();
 
+    //! Heap memory used by the filter
+    size_t DynamicMemoryUsage() const;
+
 private:
     int nEntriesPerGeneration;
     int nEntriesThisGeneration;
@@ -10,14 +10,42 @@
 #include <vector>
 
 #include <primitives/block.h>
+#include <serialize.h>
 #include <util/system.h> // for gArgs
 #include <veriblock/config.hpp>
 
 extern int testnetVBKstartHeight;
-extern std::vector<std::string> testnetVBKblocks;
+//! concatenated raw VBK block headers
+extern const unsigned char testnetVBKblocks[];
+extern const size_t testnetVBKblocksSize;
 
 extern int testnetBTCstartHeight;
-extern std::vector<std::string> testnetBTCblocks;
+//! concatenated raw BTC block headers
+extern const unsigned char testnetBTCblocks[];
+extern const size_t testnetBTCblocksSize;
+
+/**
+ * Contents of a file set with -popbootstrapfile: BTC start height (int32),
+ * BTC block headers (byte vector of concatenated raw headers), VBK start
+ * height (int32) and VBK block headers, in network serialization.
+ */
+struct PopBootstrapFile {
+    int32_t btcStartHeight{0};
+    std::vector<unsigned char> btcBlocks;
+    int32_t vbkStartHeight{0};
+    std::vector<unsigned char> vbkBlocks;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(btcStartHeight);
+        READWRITE(btcBlocks);
+        READWRITE(vbkStartHeight);
+        READWRITE(vbkBlocks);
+    }
+};
 
 struct AltChainParamsVBTC : public altintegration::AltChainParams {
     ~AltChainParamsVBTC() override = default;
@@ -54,6 +82,7 @@ void selectPopConfig(
     int btcstart = 0,
     const std::string& btcblocks = {},
     int vbkstart = 0,
-    const std::string& vbkblocks = {});
+    const std::string& vbkblocks = {},
+    const std::string& bootstrapfile = {});
 
 #endif //__BOOTSTRAPS_BTC_VBK
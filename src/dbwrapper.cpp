@@ -236,7 +236,26 @@ bool CDBWrapper::IsEmpty()
 CDBIterator::~CDBIterator() { delete piter; }
 bool CDBIterator::Valid() const { return piter->Valid(); }
 void CDBIterator::SeekToFirst() { piter->SeekToFirst(); }
+void CDBIterator::SeekToLast() { piter->SeekToLast(); }
 void CDBIterator::Next() { piter->Next(); }
+void CDBIterator::Prev() { piter->Prev(); }
+
+Span<const unsigned char> CDBIterator::GetKeyView() const
+{
+    leveldb::Slice slKey = piter->key();
+    return Span<const unsigned char>((const unsigned char*)slKey.data(), slKey.size());
+}
+
+bool CDBIterator::GetValueView(Span<const unsigned char>& value) const
+{
+    const std::vector<unsigned char>& obfuscate_key = dbwrapper_private::GetObfuscateKey(parent);
+    if (std::any_of(obfuscate_key.begin(), obfuscate_key.end(), [](unsigned char c) { return c != 0; })) {
+        return false;
+    }
+    leveldb::Slice slValue = piter->value();
+    value = Span<const unsigned char>((const unsigned char*)slValue.data(), slValue.size());
+    return true;
+}
 
 namespace dbwrapper_private {
 
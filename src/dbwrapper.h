@@ -8,6 +8,7 @@
 #include <clientversion.h>
 #include <fs.h>
 #include <serialize.h>
+#include <span.h>
 #include <streams.h>
 #include <util/system.h>
 #include <util/strencodings.h>
@@ -132,6 +133,7 @@ public:
     bool Valid() const;
 
     void SeekToFirst();
+    void SeekToLast();
 
     template<typename K> void Seek(const K& key) {
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
@@ -142,6 +144,16 @@ public:
     }
 
     void Next();
+    void Prev();
+
+    /** Serialized key, without copying. Valid until the iterator is moved. */
+    Span<const unsigned char> GetKeyView() const;
+
+    /**
+     * Serialized value, without copying. Valid until the iterator is moved.
+     * Returns false if values are obfuscated, and so can not be read in place.
+     */
+    bool GetValueView(Span<const unsigned char>& value) const;
 
     template<typename K> bool GetKey(K& key) {
         leveldb::Slice slKey = piter->key();
@@ -314,6 +326,15 @@ public:
      */
     bool IsEmpty();
 
+    /**
+     * Read a LevelDB property, like "leveldb.stats". Returns false if the
+     * property is unknown.
+     */
+    bool GetProperty(const std::string& property, std::string& value) const
+    {
+        return pdb->GetProperty(property, &value);
+    }
+
     template<typename K>
     size_t EstimateSize(const K& key_begin, const K& key_end) const
     {
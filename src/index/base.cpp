@@ -321,3 +321,13 @@ void BaseIndex::Stop()
         m_thread_sync.join();
     }
 }
+
+IndexSummary BaseIndex::GetSummary() const
+{
+    IndexSummary summary{};
+    summary.name = GetName();
+    summary.synced = m_synced;
+    const CBlockIndex* best_block_index = m_best_block_index;
+    summary.best_block_height = best_block_index ? best_block_index->nHeight : 0;
+    return summary;
+}
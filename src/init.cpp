@@ -80,8 +80,13 @@
 #include <zmq/zmqrpc.h>
 #endif
 
+#include <vbk/adaptors/repository.hpp>
 #include <vbk/log.hpp>
+#include <vbk/pop_db.hpp>
 #include <vbk/pop_service.hpp>
+#include <vbk/pop_submit.hpp>
+#include <vbk/popindex.hpp>
+#include <vbk/rpc_register.hpp>
 
 static bool fFeeEstimatesInitialized = false;
 static const bool DEFAULT_PROXYRANDOMIZE = true;
@@ -171,6 +176,9 @@ void Interrupt(NodeContext& node)
     if (g_txindex) {
         g_txindex->Interrupt();
     }
+    if (VeriBlock::g_popindex) {
+        VeriBlock::g_popindex->Interrupt();
+    }
     ForEachBlockFilterIndex([](BlockFilterIndex& index) { index.Interrupt(); });
 }
 
@@ -201,8 +209,10 @@ void Shutdown(NodeContext& node)
     // Because these depend on each-other, we make sure that neither can be
     // using the other before destroying them.
     if (node.peer_logic) UnregisterValidationInterface(node.peer_logic.get());
+    VeriBlock::UnregisterPopDataCache();
     if (node.connman) node.connman->Stop();
     if (g_txindex) g_txindex->Stop();
+    if (VeriBlock::g_popindex) VeriBlock::g_popindex->Stop();
     ForEachBlockFilterIndex([](BlockFilterIndex& index) { index.Stop(); });
 
     StopTorControl();
@@ -218,6 +228,7 @@ void Shutdown(NodeContext& node)
     node.connman.reset();
     node.banman.reset();
     g_txindex.reset();
+    VeriBlock::g_popindex.reset();
     DestroyAllBlockFilterIndexes();
 
     if (::mempool.IsLoaded() && gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
@@ -264,6 +275,7 @@ void Shutdown(NodeContext& node)
             g_chainstate->ResetCoinsViews();
         }
         pblocktree.reset();
+        VeriBlock::g_popdb.reset();
     }
     for (const auto& client : node.chain_clients) {
         client->stop();
@@ -367,6 +379,10 @@ void SetupServerArgs()
     gArgs.AddArg("-popbtcblocks", "If autoconfig is disabled, sets the blocks (must be comma separated list of 2014 BTC blocks)", ArgsManager::ALLOW_BOOL, OptionsCategory::OPTIONS);
     gArgs.AddArg("-popvbkstartheight", "If autoconfig is disabled, sets the first VBK bootstrap block height", ArgsManager::ALLOW_BOOL, OptionsCategory::OPTIONS);
     gArgs.AddArg("-popvbkblocks", "If autoconfig is disabled, sets the blocks (must be comma separated list of 100 VBK blocks)", ArgsManager::ALLOW_BOOL, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-popbootstrapfile=<file>", "Read BTC and VBK bootstrap blocks from a binary file instead of the built-in ones. Overrides -popautoconfig", ArgsManager::ALLOW_STRING, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-popdb", strprintf("Store BTC/VBK/ALT blocks in a separate database in <datadir>/pop, instead of the block index database. Existing PoP data is moved there on startup (default: %u)", VeriBlock::DEFAULT_POPDB), ArgsManager::ALLOW_BOOL, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-popdbcache=<n>", strprintf("Cache size of the PoP database in MiB, in addition to -dbcache (%d to %d, default: %d)", VeriBlock::MIN_POPDB_CACHE, VeriBlock::MAX_POPDB_CACHE, VeriBlock::DEFAULT_POPDB_CACHE), ArgsManager::ALLOW_INT, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-popwritebehind", strprintf("Queue PoP storage writes in memory and commit them with the block index, instead of syncing every write. Writes queued over %u MiB are committed early without sync. On a crash, PoP storage writes made since the last block index flush are lost (default: %u)", VeriBlock::MAX_POP_REPOSITORY_PENDING_SIZE >> 20, VeriBlock::DEFAULT_POP_WRITE_BEHIND), ArgsManager::ALLOW_BOOL, OptionsCategory::OPTIONS);
     gArgs.AddArg("-popbtcnetwork", "BTC network for pop mining: main/(test)/regtest", ArgsManager::ALLOW_STRING, OptionsCategory::OPTIONS);
     gArgs.AddArg("-popvbknetwork", "VBK network for pop mining: main/(test)/alpha/regtest", ArgsManager::ALLOW_STRING, OptionsCategory::OPTIONS);
     gArgs.AddArg("-poplogverbosity", "Verbosity for alt-cpp lib: debug/info/(warn)/error/off", ArgsManager::ALLOW_STRING, OptionsCategory::OPTIONS);
@@ -397,6 +413,8 @@ void SetupServerArgs()
     gArgs.AddArg("-minimumchainwork=<hex>", strprintf("Minimum work assumed to exist on a valid chain in hex (default: %s, testnet: %s)", defaultChainParams->GetConsensus().nMinimumChainWork.GetHex(), testnetChainParams->GetConsensus().nMinimumChainWork.GetHex()), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-par=<n>", strprintf("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)",
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-parpop=<n>", strprintf("Set the number of PoP payload verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)",
+        -GetNumCores(), VeriBlock::MAX_POPCHECK_THREADS, VeriBlock::DEFAULT_POPCHECK_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-persistmempool", strprintf("Whether to save the mempool on shutdown and load on restart (default: %u)", DEFAULT_PERSIST_MEMPOOL), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-pid=<file>", strprintf("Specify pid file. Relative paths will be prefixed by a net-specific datadir location. (default: %s)", BITCOIN_PID_FILENAME), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-prune=<n>", strprintf("Reduce storage requirements by enabling pruning (deleting) of old blocks. This allows the pruneblockchain RPC to be called to delete specific blocks, and enables automatic pruning of old blocks if a target size in MiB is provided. This mode is incompatible with -txindex and -rescan. "
@@ -410,6 +428,7 @@ void SetupServerArgs()
     hidden_args.emplace_back("-sysperms");
 #endif
     gArgs.AddArg("-txindex", strprintf("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)", DEFAULT_TXINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-popindex", strprintf("Maintain an index of PoP payloads in blocks, used by the getrawatv, getrawvtb and getrawvbkblock rpc calls (default: %u)", VeriBlock::DEFAULT_POPINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blockfilterindex=<type>",
                  strprintf("Maintain an index of compact filters by block (default: %s, values: %s).", DEFAULT_BLOCKFILTERINDEX, ListBlockFilterTypes()) +
                  " If <type> is not supplied or if <type> = 1, indexes for all known types are enabled.",
@@ -472,19 +491,35 @@ void SetupServerArgs()
     gArgs.AddArg("-zmqpubhashtx=<address>", "Enable publish hash transaction in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawblock=<address>", "Enable publish raw block in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawtx=<address>", "Enable publish raw transaction in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubrawatv=<address>", "Enable publish raw ATV added to PoP mempool in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubrawvtb=<address>", "Enable publish raw VTB added to PoP mempool in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubrawvbkblock=<address>", "Enable publish raw VBK block added to PoP mempool in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubpoptip=<address>", "Enable publish PoP tip (block, best VBK and BTC block hashes) in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubhashblockhwm=<n>", strprintf("Set publish hash block outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubhashtxhwm=<n>", strprintf("Set publish hash transaction outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawblockhwm=<n>", strprintf("Set publish raw block outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawtxhwm=<n>", strprintf("Set publish raw transaction outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubrawatvhwm=<n>", strprintf("Set publish raw ATV outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubrawvtbhwm=<n>", strprintf("Set publish raw VTB outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubrawvbkblockhwm=<n>", strprintf("Set publish raw VBK block outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubpoptiphwm=<n>", strprintf("Set publish PoP tip outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
 #else
     hidden_args.emplace_back("-zmqpubhashblock=<address>");
     hidden_args.emplace_back("-zmqpubhashtx=<address>");
     hidden_args.emplace_back("-zmqpubrawblock=<address>");
     hidden_args.emplace_back("-zmqpubrawtx=<address>");
+    hidden_args.emplace_back("-zmqpubrawatv=<address>");
+    hidden_args.emplace_back("-zmqpubrawvtb=<address>");
+    hidden_args.emplace_back("-zmqpubrawvbkblock=<address>");
+    hidden_args.emplace_back("-zmqpubpoptip=<address>");
     hidden_args.emplace_back("-zmqpubhashblockhwm=<n>");
     hidden_args.emplace_back("-zmqpubhashtxhwm=<n>");
     hidden_args.emplace_back("-zmqpubrawblockhwm=<n>");
     hidden_args.emplace_back("-zmqpubrawtxhwm=<n>");
+    hidden_args.emplace_back("-zmqpubrawatvhwm=<n>");
+    hidden_args.emplace_back("-zmqpubrawvtbhwm=<n>");
+    hidden_args.emplace_back("-zmqpubrawvbkblockhwm=<n>");
+    hidden_args.emplace_back("-zmqpubpoptiphwm=<n>");
 #endif
 
     gArgs.AddArg("-checkblocks=<n>", strprintf("How many blocks to check at startup (default: %u, 0 = all)", DEFAULT_CHECKBLOCKS), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
@@ -973,6 +1008,8 @@ bool AppInitParameterInteraction()
     if (gArgs.GetArg("-prune", 0)) {
         if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX))
             return InitError(_("Prune mode is incompatible with -txindex.").translated);
+        if (gArgs.GetBoolArg("-popindex", VeriBlock::DEFAULT_POPINDEX))
+            return InitError(_("Prune mode is incompatible with -popindex.").translated);
         if (!g_enabled_filter_types.empty()) {
             return InitError(_("Prune mode is incompatible with -blockfilterindex.").translated);
         }
@@ -1278,6 +1315,27 @@ bool AppInitMain(NodeContext& node)
         }
     }
 
+    int pop_threads = gArgs.GetArg("-parpop", VeriBlock::DEFAULT_POPCHECK_THREADS);
+    if (pop_threads <= 0) {
+        pop_threads += GetNumCores();
+    }
+
+    // Subtract 1 because the main thread counts towards the parpop threads
+    pop_threads = std::max(pop_threads - 1, 0);
+    pop_threads = std::min(pop_threads, VeriBlock::MAX_POPCHECK_THREADS);
+
+    LogPrintf("PoP payload verification uses %d additional threads\n", pop_threads);
+    if (pop_threads >= 1) {
+        VeriBlock::g_parallel_pop_checks = true;
+        for (int i = 0; i < pop_threads; ++i) {
+            threadGroup.create_thread([i]() { return VeriBlock::ThreadPopCheck(i); });
+        }
+    }
+
+    threadGroup.create_thread(VeriBlock::ThreadPopSubmit);
+
+    VeriBlock::g_pop_write_behind = gArgs.GetBoolArg("-popwritebehind", VeriBlock::DEFAULT_POP_WRITE_BEHIND);
+
     // Start the lightweight task scheduler thread
     CScheduler::Function serviceLoop = std::bind(&CScheduler::serviceQueue, &scheduler);
     threadGroup.create_thread(std::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
@@ -1453,6 +1511,8 @@ bool AppInitMain(NodeContext& node)
     nTotalCache -= nBlockTreeDBCache;
     int64_t nTxIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX) ? nMaxTxIndexCache << 20 : 0);
     nTotalCache -= nTxIndexCache;
+    int64_t nPopIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-popindex", VeriBlock::DEFAULT_POPINDEX) ? nMaxTxIndexCache << 20 : 0);
+    nTotalCache -= nPopIndexCache;
     int64_t filter_index_cache = 0;
     if (!g_enabled_filter_types.empty()) {
         size_t n_indexes = g_enabled_filter_types.size();
@@ -1464,12 +1524,23 @@ bool AppInitMain(NodeContext& node)
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
     nCoinCacheUsage = nTotalCache; // the rest goes to in-memory cache
+    // PoP database has its own budget
+    const bool fPopDB = gArgs.GetBoolArg("-popdb", VeriBlock::DEFAULT_POPDB);
+    int64_t nPopDBCache = gArgs.GetArg("-popdbcache", VeriBlock::DEFAULT_POPDB_CACHE);
+    nPopDBCache = std::max(nPopDBCache, VeriBlock::MIN_POPDB_CACHE);
+    nPopDBCache = std::min(nPopDBCache, VeriBlock::MAX_POPDB_CACHE) << 20;
     int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1f MiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
     if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
         LogPrintf("* Using %.1f MiB for transaction index database\n", nTxIndexCache * (1.0 / 1024 / 1024));
     }
+    if (gArgs.GetBoolArg("-popindex", VeriBlock::DEFAULT_POPINDEX)) {
+        LogPrintf("* Using %.1f MiB for PoP payload index database\n", nPopIndexCache * (1.0 / 1024 / 1024));
+    }
+    if (fPopDB) {
+        LogPrintf("* Using %.1f MiB for PoP database\n", nPopDBCache * (1.0 / 1024 / 1024));
+    }
     for (BlockFilterType filter_type : g_enabled_filter_types) {
         LogPrintf("* Using %.1f MiB for %s block filter index database\n",
                   filter_index_cache * (1.0 / 1024 / 1024), BlockFilterTypeName(filter_type));
@@ -1497,7 +1568,25 @@ bool AppInitMain(NodeContext& node)
                 // fails if it's still open from the previous loop. Close it first:
                 pblocktree.reset();
                 pblocktree.reset(new CBlockTreeDB(nBlockTreeDBCache, false, fReset));
-                VeriBlock::SetPop(*pblocktree);
+                VeriBlock::g_popdb.reset();
+                if (fPopDB) {
+                    VeriBlock::g_popdb.reset(new VeriBlock::PopDB(nPopDBCache, false, fReset));
+                    if (!VeriBlock::g_popdb->MigrateFrom(*pblocktree)) {
+                        strLoadError = _("Error moving PoP data into the PoP database").translated;
+                        break;
+                    }
+                    VeriBlock::SetPop(*VeriBlock::g_popdb, pblocktree.get());
+                } else {
+                    if (VeriBlock::PopDB::Exists()) {
+                        if (!fReset) {
+                            strLoadError = _("PoP data is stored in a separate database. Restart with -popdb or -reindex").translated;
+                            break;
+                        }
+                        // reindex rebuilds PoP data in block tree db
+                        VeriBlock::PopDB::Destroy();
+                    }
+                    VeriBlock::SetPop(*pblocktree);
+                }
 
                 if (fReset) {
                     pblocktree->WriteReindexing(true);
@@ -1679,6 +1768,14 @@ bool AppInitMain(NodeContext& node)
         g_txindex->Start();
     }
 
+    if (gArgs.GetBoolArg("-popindex", VeriBlock::DEFAULT_POPINDEX)) {
+        VeriBlock::g_popindex = MakeUnique<VeriBlock::PopIndex>(nPopIndexCache, false, fReindex);
+        VeriBlock::g_popindex->Start();
+    }
+
+    // getpopdata cache starts at the loaded tip
+    VeriBlock::RegisterPopDataCache();
+
     for (const auto& filter_type : g_enabled_filter_types) {
         InitBlockFilterIndex(filter_type, filter_index_cache, false, fReindex);
         GetBlockFilterIndex(filter_type)->Start();
@@ -142,8 +142,12 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
 
     addPackageTxs<ancestor_score>(nPackagesSelected, nDescendantsUpdated);
 
-    // VeriBlock: add PopData into the block
-    pblock->popData = VeriBlock::getPopData();
+    // VeriBlock: add PopData into the block. It does not count towards block
+    // weight, but the serialized block still has to fit into
+    // MAX_BLOCK_SERIALIZED_SIZE, and weight is an upper bound of its size
+    // without PopData.
+    const size_t nPopMaxSize = MAX_BLOCK_SERIALIZED_SIZE - std::min<uint64_t>(nBlockWeight, MAX_BLOCK_SERIALIZED_SIZE);
+    pblock->popData = VeriBlock::selectPopData(*pindexPrev, nPopMaxSize);
     if (!pblock->popData.atvs.empty() || !pblock->popData.context.empty() || !pblock->popData.vtbs.empty()) {
         pblock->nVersion |= VeriBlock::POP_BLOCK_VERSION_BIT;
     }
@@ -845,6 +845,7 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats) {
         if (queue.pindex)
             stats.vHeightInFlight.push_back(queue.pindex->nHeight);
     }
+    stats.nPopRelayMemory = VeriBlock::p2p::getPopDataNodeStateMemoryUsage(nodeid);
     return true;
 }
 
@@ -1203,7 +1204,6 @@ static bool fWitnessesPresentInMostRecentCompactBlock GUARDED_BY(cs_most_recent_
  */
 void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock) {
     std::shared_ptr<const CBlockHeaderAndShortTxIDs> pcmpctblock = std::make_shared<const CBlockHeaderAndShortTxIDs> (*pblock, true);
-    const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
 
     LOCK(cs_main);
 
@@ -1223,7 +1223,7 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
         fWitnessesPresentInMostRecentCompactBlock = fWitnessEnabled;
     }
 
-    connman->ForEachNode([this, &pcmpctblock, pindex, &msgMaker, fWitnessEnabled, &hashBlock](CNode* pnode) {
+    connman->ForEachNode([this, &pcmpctblock, pindex, fWitnessEnabled, &hashBlock](CNode* pnode) {
         AssertLockHeld(cs_main);
 
         // TODO: Avoid the repeated-serialization here
@@ -1238,6 +1238,8 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
 
             LogPrint(BCLog::NET, "%s sending header-and-ids %s to peer=%d\n", "PeerLogicValidation::NewPoWValidBlock",
                     hashBlock.ToString(), pnode->GetId());
+            // VeriBlock: peers below POP_SHORT_IDS_VERSION get full PoP data
+            const CNetMsgMaker msgMaker(pnode->GetSendVersion());
             connman->PushMessage(pnode, msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock));
             state.pindexBestHeaderSent = pindex;
         }
@@ -1652,6 +1654,17 @@ static uint32_t GetFetchFlags(CNode* pfrom) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
     return nFetchFlags;
 }
 
+template <typename pop_t>
+static bool GetRequestedPopPayloads(const std::vector<pop_t>& payloads, const std::vector<uint16_t>& indexes, std::vector<pop_t>& out)
+{
+    out.reserve(indexes.size());
+    for (const uint16_t index : indexes) {
+        if (index >= payloads.size()) return false;
+        out.push_back(payloads[index]);
+    }
+    return true;
+}
+
 inline void static SendBlockTransactions(const CBlock& block, const BlockTransactionsRequest& req, CNode* pfrom, CConnman* connman) {
     BlockTransactions resp(req);
     for (size_t i = 0; i < req.indexes.size(); i++) {
@@ -1667,7 +1680,16 @@ inline void static SendBlockTransactions(const CBlock& block, const BlockTransac
     int nSendFlags = State(pfrom->GetId())->fWantsCmpctWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS;
 
     //VeriBlock add popData
-    resp.popData = block.popData;
+    if (pfrom->GetSendVersion() >= POP_SHORT_IDS_VERSION) {
+        if (!GetRequestedPopPayloads(block.popData.context, req.vbk_indexes, resp.popData.context) ||
+            !GetRequestedPopPayloads(block.popData.vtbs, req.vtb_indexes, resp.popData.vtbs) ||
+            !GetRequestedPopPayloads(block.popData.atvs, req.atv_indexes, resp.popData.atvs)) {
+            Misbehaving(pfrom->GetId(), 100, strprintf("Peer %d sent us a getblocktxn with out-of-bounds pop data indices", pfrom->GetId()));
+            return;
+        }
+    } else {
+        resp.popData = block.popData;
+    }
 
     connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::BLOCKTXN, resp));
 }
@@ -2786,7 +2808,8 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                     if (!partialBlock.IsTxAvailable(i))
                         req.indexes.push_back(i);
                 }
-                if (req.indexes.empty()) {
+                partialBlock.GetMissingPopData(req);
+                if (req.indexes.empty() && !req.HasPopIndexes()) {
                     // Dirty hack to jump to BLOCKTXN code (TODO: move message handling into their own functions)
                     BlockTransactions txn;
                     txn.blockhash = cmpctblock.header.GetHash();
@@ -3988,11 +4011,7 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
             connman->PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
 
         // VeriBlock offer Pop Data
-        {
-            VeriBlock::p2p::offerPopData<altintegration::ATV>(pto, connman, msgMaker);
-            VeriBlock::p2p::offerPopData<altintegration::VTB>(pto, connman, msgMaker);
-            VeriBlock::p2p::offerPopData<altintegration::VbkBlock>(pto, connman, msgMaker);
-        }
+        VeriBlock::p2p::sendPopInventory(pto, connman, msgMaker, current_time);
 
         // Detect whether we're stalling
         current_time = GetTime<std::chrono::microseconds>();
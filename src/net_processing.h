@@ -81,6 +81,7 @@ struct CNodeStateStats {
     int nSyncHeight = -1;
     int nCommonHeight = -1;
     std::vector<int> vHeightInFlight;
+    size_t nPopRelayMemory = 0;
 };
 
 /** Get statistics from node state */
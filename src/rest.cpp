@@ -20,6 +20,9 @@
 #include <util/check.h>
 #include <util/strencodings.h>
 #include <validation.h>
+#include <vbk/adaptors/univalue_json.hpp>
+#include <vbk/pop_common.hpp>
+#include <vbk/rpc_register.hpp>
 #include <version.h>
 
 #include <boost/algorithm/string.hpp>
@@ -646,6 +649,210 @@ static bool rest_blockhash_by_height(HTTPRequest* req,
     }
 }
 
+/**
+ * Reply with PoP entities, written by serialize into a stream in the same
+ * encoding as blocks and P2P messages use for .bin and .hex, or made by toJSON
+ * for .json. Only the requested format is made.
+ */
+template <typename Serialize, typename ToJSON>
+static bool RESTPopReply(HTTPRequest* req, RetFormat rf, Serialize serialize, ToJSON toJSON)
+{
+    switch (rf) {
+    case RetFormat::BINARY: {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        serialize(ss);
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, ss.str());
+        return true;
+    }
+    case RetFormat::HEX: {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        serialize(ss);
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, HexStr(ss.begin(), ss.end()) + "\n");
+        return true;
+    }
+    case RetFormat::JSON: {
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, toJSON().write() + "\n");
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+}
+
+template <typename hash_t>
+static bool ParsePopHash(HTTPRequest* req, const std::string& hashStr, hash_t& hash)
+{
+    try {
+        hash = hash_t::fromHex(hashStr);
+    } catch (const std::exception&) {
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + SanitizeString(hashStr));
+    }
+    return true;
+}
+
+template <typename Tree>
+static bool rest_pop_block(HTTPRequest* req, const std::string& strURIPart, Tree& tree)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string hashStr;
+    const RetFormat rf = ParseDataFormat(hashStr, strURIPart);
+
+    typename Tree::block_t::hash_t hash;
+    if (!ParsePopHash(req, hashStr, hash))
+        return false;
+
+    LOCK(cs_main);
+    const auto* index = tree.getBlockIndex(hash);
+    if (!index)
+        return RESTERR(req, HTTP_NOT_FOUND, SanitizeString(hashStr) + " not found");
+
+    return RESTPopReply(
+        req, rf, [&](CDataStream& ss) { ss << *index; },
+        [&]() { return altintegration::ToJSON<UniValue>(*index); });
+}
+
+static bool rest_vbkblock(HTTPRequest* req, const std::string& strURIPart)
+{
+    return rest_pop_block(req, strURIPart, VeriBlock::GetPop().altTree->vbk());
+}
+
+static bool rest_btcblock(HTTPRequest* req, const std::string& strURIPart)
+{
+    return rest_pop_block(req, strURIPart, VeriBlock::GetPop().altTree->btc());
+}
+
+static bool rest_vbkheaders(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "No header count specified. Use /rest/vbkheaders/<count>/<hash>.<ext>.");
+
+    long count = strtol(path[0].c_str(), nullptr, 10);
+    if (count < 1 || count > 2000)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Header count out of range: " + SanitizeString(path[0]));
+
+    altintegration::VbkBlock::hash_t hash;
+    if (!ParsePopHash(req, path[1], hash))
+        return false;
+
+    // headers of the best VBK chain, starting at hash
+    std::vector<altintegration::VbkBlock> headers;
+    headers.reserve(count);
+    {
+        LOCK(cs_main);
+        auto& vbk = VeriBlock::GetPop().altTree->vbk();
+        const auto& chain = vbk.getBestChain();
+        const auto* index = vbk.getBlockIndex(hash);
+        while (index != nullptr && chain.contains(index)) {
+            headers.push_back(index->getHeader());
+            if (headers.size() == (unsigned long)count)
+                break;
+            index = chain[index->getHeight() + 1];
+        }
+    }
+
+    return RESTPopReply(
+        req, rf,
+        [&](CDataStream& ss) {
+            for (const auto& header : headers) {
+                ss << header;
+            }
+        },
+        [&]() {
+            UniValue jsonHeaders(UniValue::VARR);
+            for (const auto& header : headers) {
+                jsonHeaders.push_back(altintegration::ToJSON<UniValue>(header));
+            }
+            return jsonHeaders;
+        });
+}
+
+template <typename pop_t>
+static void GetPopMempoolPayloads(altintegration::MemPool& mempool, std::vector<pop_t>& payloads) EXCLUSIVE_LOCKS_REQUIRED(VeriBlock::cs_popmempool)
+{
+    for (const auto& el : mempool.getMap<pop_t>()) {
+        payloads.push_back(*mempool.get<pop_t>(el.first));
+    }
+}
+
+static bool rest_popmempool(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+
+    // .bin and .hex are PopData with all payloads, as it is encoded in blocks
+    LOCK(VeriBlock::cs_popmempool);
+    auto& mempool = *VeriBlock::GetPop().mempool;
+    return RESTPopReply(
+        req, rf,
+        [&](CDataStream& ss) {
+            altintegration::PopData popData;
+            GetPopMempoolPayloads(mempool, popData.context);
+            GetPopMempoolPayloads(mempool, popData.vtbs);
+            GetPopMempoolPayloads(mempool, popData.atvs);
+            ss << popData;
+        },
+        [&]() { return altintegration::ToJSON<UniValue>(mempool); });
+}
+
+template <typename pop_t>
+static bool rest_payload(HTTPRequest* req, RetFormat rf, const std::string& idStr)
+{
+    typename pop_t::id_t id;
+    try {
+        id = pop_t::id_t::fromHex(idStr);
+    } catch (const std::exception&) {
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid id: " + SanitizeString(idStr));
+    }
+
+    pop_t payload;
+    std::vector<uint256> containingBlocks;
+    try {
+        if (!VeriBlock::GetPayload<pop_t>(id, payload, Params().GetConsensus(), nullptr, containingBlocks))
+            return RESTERR(req, HTTP_NOT_FOUND, SanitizeString(idStr) + " not found");
+    } catch (const UniValue& objError) {
+        return RESTERR(req, HTTP_NOT_FOUND, find_value(objError, "message").get_str());
+    }
+
+    return RESTPopReply(
+        req, rf, [&](CDataStream& ss) { ss << payload; },
+        [&]() { return altintegration::ToJSON<UniValue>(payload); });
+}
+
+static bool rest_payload(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Use /rest/payload/<atv|vtb|vbkblock>/<id>.<ext>.");
+
+    if (path[0] == "atv")
+        return rest_payload<altintegration::ATV>(req, rf, path[1]);
+    if (path[0] == "vtb")
+        return rest_payload<altintegration::VTB>(req, rf, path[1]);
+    if (path[0] == "vbkblock")
+        return rest_payload<altintegration::VbkBlock>(req, rf, path[1]);
+    return RESTERR(req, HTTP_BAD_REQUEST, "Unknown payload type: " + SanitizeString(path[0]));
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
@@ -659,6 +866,11 @@ static const struct {
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
       {"/rest/blockhashbyheight/", rest_blockhash_by_height},
+      {"/rest/vbkblock/", rest_vbkblock},
+      {"/rest/btcblock/", rest_btcblock},
+      {"/rest/vbkheaders/", rest_vbkheaders},
+      {"/rest/popmempool", rest_popmempool},
+      {"/rest/payload/", rest_payload},
 };
 
 void StartREST()
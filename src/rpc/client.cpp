@@ -181,7 +181,13 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "getnodeaddresses", 0, "count"},
     { "stop", 0, "wait" },
     { "getpopdata", 0, "block_height"},
+    { "getpopdatarange", 0, "first_height"},
+    { "getpopdatarange", 1, "last_height"},
+    { "submitpop", 0, "vbk_blocks"},
     { "submitpop", 1, "vtbs"},
+    { "submitpop", 2, "atvs"},
+    { "submitpop", 3, "async"},
+    { "getpopstats", 0, "reset"},
 };
 // clang-format on
 
@@ -6,6 +6,8 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <httpserver.h>
+#include <index/blockfilterindex.h>
+#include <index/txindex.h>
 #include <key_io.h>
 #include <outputtype.h>
 #include <rpc/blockchain.h>
@@ -16,6 +18,7 @@
 #include <util/strencodings.h>
 #include <util/system.h>
 #include <util/validation.h>
+#include <vbk/popindex.hpp>
 
 #include <stdint.h>
 #include <tuple>
@@ -537,6 +540,60 @@ UniValue logging(const JSONRPCRequest& request)
     return result;
 }
 
+static UniValue SummaryToJSON(const IndexSummary&& summary, std::string index_name)
+{
+    UniValue ret_summary(UniValue::VOBJ);
+    if (!index_name.empty() && index_name != summary.name) return ret_summary;
+
+    UniValue entry(UniValue::VOBJ);
+    entry.pushKV("synced", summary.synced);
+    entry.pushKV("best_block_height", summary.best_block_height);
+    ret_summary.pushKV(summary.name, entry);
+    return ret_summary;
+}
+
+static UniValue getindexinfo(const JSONRPCRequest& request)
+{
+    RPCHelpMan{"getindexinfo",
+        "\nReturns the status of one or all available indices currently running in the node.\n",
+        {
+            {"index_name", RPCArg::Type::STR, RPCArg::Optional::OMITTED_NAMED_ARG, "Filter results for an index with a specific name."},
+        },
+        RPCResult{
+            "{\n"
+            "  \"name\": {                  (json object) The name of the index\n"
+            "    \"synced\": true|false,     (boolean) Whether the index is synced or not\n"
+            "    \"best_block_height\": n,   (numeric) The block height to which the index is synced\n"
+            "  },\n"
+            "  ...\n"
+            "}\n"
+        },
+        RPCExamples{
+            HelpExampleCli("getindexinfo", "")
+          + HelpExampleRpc("getindexinfo", "")
+          + HelpExampleCli("getindexinfo", "popindex")
+          + HelpExampleRpc("getindexinfo", "popindex")
+        },
+    }.Check(request);
+
+    UniValue result(UniValue::VOBJ);
+    const std::string index_name = request.params[0].isNull() ? "" : request.params[0].get_str();
+
+    if (g_txindex) {
+        result.pushKVs(SummaryToJSON(g_txindex->GetSummary(), index_name));
+    }
+
+    if (VeriBlock::g_popindex) {
+        result.pushKVs(SummaryToJSON(VeriBlock::g_popindex->GetSummary(), index_name));
+    }
+
+    ForEachBlockFilterIndex([&result, &index_name](const BlockFilterIndex& index) {
+        result.pushKVs(SummaryToJSON(index.GetSummary(), index_name));
+    });
+
+    return result;
+}
+
 static UniValue echo(const JSONRPCRequest& request)
 {
     if (request.fHelp)
@@ -569,6 +626,7 @@ static const CRPCCommand commands[] =
     { "util",               "getdescriptorinfo",      &getdescriptorinfo,      {"descriptor"} },
     { "util",               "verifymessage",          &verifymessage,          {"address","signature","message"} },
     { "util",               "signmessagewithprivkey", &signmessagewithprivkey, {"privkey","message"} },
+    { "util",               "getindexinfo",           &getindexinfo,           {"index_name"} },
 
     /* Not shown in help */
     { "hidden",             "setmocktime",            &setmocktime,            {"timestamp"}},
@@ -17,7 +17,7 @@
 #include <stdint.h>
 
 #include <boost/thread.hpp>
-#include <vbk/adaptors/batch_adapter.hpp>
+#include <vbk/pop_db.hpp>
 #include <vbk/pop_service.hpp>
 
 static const char DB_COIN = 'C';
@@ -234,11 +234,22 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
         batch.Write(std::make_pair(DB_BLOCK_INDEX, (*it)->GetBlockHash()), CDiskBlockIndex(*it));
     }
 
-    // write BTC/VBK/ALT blocks
-    auto adaptor = VeriBlock::BatchAdapter(batch);
-    VeriBlock::saveTrees(adaptor);
+    // write BTC/VBK/ALT blocks, before the block index which refers to them
+    if (VeriBlock::g_popdb) {
+        if (!VeriBlock::g_popdb->WriteTrees()) {
+            return false;
+        }
+    } else {
+        VeriBlock::saveTrees(batch);
+    }
 
-    return WriteBatch(batch, true);
+    if (!WriteBatch(batch, true)) {
+        return false;
+    }
+    if (!VeriBlock::g_popdb) {
+        VeriBlock::onTreesSaved();
+    }
+    return true;
 }
 
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
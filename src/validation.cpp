@@ -50,6 +50,7 @@
 #include <validationinterface.h>
 #include <warnings.h>
 
+#include <vbk/pop_db.hpp>
 #include <vbk/pop_service.hpp>
 #include <vbk/util.hpp>
 
@@ -1398,6 +1399,7 @@ void CChainState::InvalidBlockFound(CBlockIndex* pindex, const BlockValidationSt
         VeriBlock::GetPop()
             .altTree
             ->invalidateSubtree(pindex->GetBlockHash().asVector(), altintegration::BLOCK_FAILED_BLOCK);
+        VeriBlock::onPopStateChanged();
 
         m_blockman.m_failed_blocks.insert(pindex);
         setDirtyBlockIndex.insert(pindex);
@@ -2141,8 +2143,9 @@ bool CChainState::ConnectBlock(const CBlock& block, BlockValidationState& state,
         UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
     }
 
+    // VeriBlock: PoP validity of blocks which are only checked is tested by TestBlockValidity
     altintegration::ValidationState _state;
-    if (!VeriBlock::setState(pindex->GetBlockHash(), _state)) {
+    if (!fJustCheck && !VeriBlock::setState(pindex->GetBlockHash(), _state)) {
         return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, "bad-block-pop", strprintf("Block %s is POP invalid: %s", pindex->GetBlockHash().ToString(), _state.toString()));
     }
 
@@ -2939,6 +2942,14 @@ bool CChainState::ActivateBestChain(BlockValidationState& state, const CChainPar
                 // Notify ValidationInterface subscribers
                 GetMainSignals().UpdatedBlockTip(pindexNewTip, pindexFork, fInitialDownload);
 
+                // PoP state follows the active tip, see UpdateTip
+                auto& altTree = *VeriBlock::GetPop().altTree;
+                const auto* vbkTip = altTree.vbk().getBestChain().tip();
+                const auto* btcTip = altTree.btc().getBestChain().tip();
+                if (!fInitialDownload && vbkTip && btcTip) {
+                    GetMainSignals().UpdatedPopTip(pindexNewTip, vbkTip->getHeader(), btcTip->getHeader());
+                }
+
                 // Always notify the UI if a new block tip was connected
                 uiInterface.NotifyBlockTip(fInitialDownload, pindexNewTip);
             }
@@ -3155,6 +3166,7 @@ void CChainState::ResetBlockFailureFlags(CBlockIndex* pindex)
     int nHeight = pindex->nHeight;
     auto blockHash = pindex->GetBlockHash().asVector();
     VeriBlock::GetPop().altTree->revalidateSubtree(blockHash, altintegration::BLOCK_FAILED_BLOCK, true);
+    VeriBlock::onPopStateChanged();
 
     // Remove the invalidity flag from this block and all its descendants.
     BlockMap::iterator it = m_blockman.m_block_index.begin();
@@ -3915,24 +3927,9 @@ bool TestBlockValidity(BlockValidationState& state, const CChainParams& chainpar
     if (!ContextualCheckBlock(block, state, chainparams.GetConsensus(), pindexPrev, fCheckMerkleRoot))
         return error("%s: Consensus::ContextualCheckBlock: %s", __func__, state.GetRejectReason());
 
-    // VeriBlock: Block that have been passed to TestBlockValidity may not exist in alt tree, because technically it was not created ("mined").
-    // in this case, add it and then remove
-    auto& tree = *VeriBlock::GetPop().altTree;
-    auto _hash = block_hash.asVector();
-    bool shouldRemove = false;
-    if (!tree.getBlockIndex(_hash)) {
-        shouldRemove = true;
-        auto containing = VeriBlock::blockToAltBlock(indexDummy);
-        altintegration::ValidationState _state;
-        bool ret = tree.acceptBlockHeader(containing, _state);
-        assert(ret && "alt tree can not accept alt block");
-    }
-
-    auto _f = altintegration::Finalizer([shouldRemove, _hash, &tree]() {
-        if (shouldRemove) {
-            tree.removeSubtree(_hash);
-        }
-    });
+    // VeriBlock: template is not added into alt tree, so ConnectBlock does not switch PoP state to it
+    if (!VeriBlock::testBlockPopValidity(block, *pindexPrev, state))
+        return error("%s: VeriBlock::testBlockPopValidity: %s", __func__, FormatStateMessage(state));
 
     if (!::ChainstateActive().ConnectBlock(block, state, &indexDummy, viewNew, chainparams, true))
         return false;
@@ -4160,7 +4157,7 @@ bool BlockManager::LoadBlockIndex(
     if (!blocktree.LoadBlockIndexGuts(consensus_params, [this](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return this->InsertBlockIndex(hash); }))
         return false;
 
-    bool hasPopData = VeriBlock::hasPopData(blocktree);
+    bool hasPopData = VeriBlock::hasPopData(VeriBlock::GetPopDB());
 
     if(!hasPopData) {
         LogPrintf("BTC/VBK/ALT tips not found... skipping block index loading\n");
@@ -4213,8 +4210,7 @@ bool BlockManager::LoadBlockIndex(
         AssertLockHeld(cs_main);
 
         // load blocks
-        std::unique_ptr<CDBIterator> pcursor(blocktree.NewIterator());
-        if (!VeriBlock::loadTrees(*pcursor)) {
+        if (!VeriBlock::loadTrees(VeriBlock::GetPopDB())) {
             return false;
         }
 
@@ -23,6 +23,10 @@ struct ValidationInterfaceConnections {
     boost::signals2::scoped_connection ChainStateFlushed;
     boost::signals2::scoped_connection BlockChecked;
     boost::signals2::scoped_connection NewPoWValidBlock;
+    boost::signals2::scoped_connection ATVAddedToPopMempool;
+    boost::signals2::scoped_connection VTBAddedToPopMempool;
+    boost::signals2::scoped_connection VbkBlockAddedToPopMempool;
+    boost::signals2::scoped_connection UpdatedPopTip;
 };
 
 struct MainSignalsInstance {
@@ -34,6 +38,10 @@ struct MainSignalsInstance {
     boost::signals2::signal<void (const CBlockLocator &)> ChainStateFlushed;
     boost::signals2::signal<void (const CBlock&, const BlockValidationState&)> BlockChecked;
     boost::signals2::signal<void (const CBlockIndex *, const std::shared_ptr<const CBlock>&)> NewPoWValidBlock;
+    boost::signals2::signal<void (const altintegration::ATV&)> ATVAddedToPopMempool;
+    boost::signals2::signal<void (const altintegration::VTB&)> VTBAddedToPopMempool;
+    boost::signals2::signal<void (const altintegration::VbkBlock&)> VbkBlockAddedToPopMempool;
+    boost::signals2::signal<void (const CBlockIndex *, const altintegration::VbkBlock&, const altintegration::BtcBlock&)> UpdatedPopTip;
 
     // We are not allowed to assume the scheduler only runs in one thread,
     // but must ensure all callbacks happen in-order, so we end up creating
@@ -81,6 +89,10 @@ void RegisterValidationInterface(CValidationInterface* pwalletIn) {
     conns.ChainStateFlushed = g_signals.m_internals->ChainStateFlushed.connect(std::bind(&CValidationInterface::ChainStateFlushed, pwalletIn, std::placeholders::_1));
     conns.BlockChecked = g_signals.m_internals->BlockChecked.connect(std::bind(&CValidationInterface::BlockChecked, pwalletIn, std::placeholders::_1, std::placeholders::_2));
     conns.NewPoWValidBlock = g_signals.m_internals->NewPoWValidBlock.connect(std::bind(&CValidationInterface::NewPoWValidBlock, pwalletIn, std::placeholders::_1, std::placeholders::_2));
+    conns.ATVAddedToPopMempool = g_signals.m_internals->ATVAddedToPopMempool.connect(std::bind(&CValidationInterface::ATVAddedToPopMempool, pwalletIn, std::placeholders::_1));
+    conns.VTBAddedToPopMempool = g_signals.m_internals->VTBAddedToPopMempool.connect(std::bind(&CValidationInterface::VTBAddedToPopMempool, pwalletIn, std::placeholders::_1));
+    conns.VbkBlockAddedToPopMempool = g_signals.m_internals->VbkBlockAddedToPopMempool.connect(std::bind(&CValidationInterface::VbkBlockAddedToPopMempool, pwalletIn, std::placeholders::_1));
+    conns.UpdatedPopTip = g_signals.m_internals->UpdatedPopTip.connect(std::bind(&CValidationInterface::UpdatedPopTip, pwalletIn, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
 }
 
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
@@ -159,3 +171,28 @@ void CMainSignals::BlockChecked(const CBlock& block, const BlockValidationState&
 void CMainSignals::NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &block) {
     m_internals->NewPoWValidBlock(pindex, block);
 }
+
+void CMainSignals::PopPayloadAddedToMempool(const altintegration::ATV& atv) {
+    m_internals->m_schedulerClient.AddToProcessQueue([atv, this] {
+        m_internals->ATVAddedToPopMempool(atv);
+    });
+}
+
+void CMainSignals::PopPayloadAddedToMempool(const altintegration::VTB& vtb) {
+    m_internals->m_schedulerClient.AddToProcessQueue([vtb, this] {
+        m_internals->VTBAddedToPopMempool(vtb);
+    });
+}
+
+void CMainSignals::PopPayloadAddedToMempool(const altintegration::VbkBlock& block) {
+    m_internals->m_schedulerClient.AddToProcessQueue([block, this] {
+        m_internals->VbkBlockAddedToPopMempool(block);
+    });
+}
+
+void CMainSignals::UpdatedPopTip(const CBlockIndex *pindexNew, const altintegration::VbkBlock& vbkTip, const altintegration::BtcBlock& btcTip) {
+    // Delivered in order with UpdatedBlockTip, see there
+    m_internals->m_schedulerClient.AddToProcessQueue([pindexNew, vbkTip, btcTip, this] {
+        m_internals->UpdatedPopTip(pindexNew, vbkTip, btcTip);
+    });
+}
@@ -8,6 +8,7 @@
 
 #include <primitives/transaction.h> // CTransaction(Ref)
 #include <sync.h>
+#include <veriblock/entities/popdata.hpp>
 
 #include <functional>
 #include <memory>
@@ -141,6 +142,22 @@ protected:
      * Notifies listeners that a block which builds directly on our current tip
      * has been received and connected to the headers tree, though not validated yet */
     virtual void NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& block) {};
+    /**
+     * Notifies listeners of a PoP payload having been added to PoP mempool.
+     *
+     * Called on a background thread.
+     */
+    virtual void ATVAddedToPopMempool(const altintegration::ATV& atv) {}
+    virtual void VTBAddedToPopMempool(const altintegration::VTB& vtb) {}
+    virtual void VbkBlockAddedToPopMempool(const altintegration::VbkBlock& block) {}
+    /**
+     * Notifies listeners of PoP state having been set to the new active tip,
+     * along with the best VBK and BTC blocks of that state. Fires right
+     * after UpdatedBlockTip, except during initial block download.
+     *
+     * Called on a background thread.
+     */
+    virtual void UpdatedPopTip(const CBlockIndex *pindexNew, const altintegration::VbkBlock& vbkTip, const altintegration::BtcBlock& btcTip) {}
     friend void ::RegisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
@@ -175,6 +192,10 @@ public:
     void ChainStateFlushed(const CBlockLocator &);
     void BlockChecked(const CBlock&, const BlockValidationState&);
     void NewPoWValidBlock(const CBlockIndex *, const std::shared_ptr<const CBlock>&);
+    void PopPayloadAddedToMempool(const altintegration::ATV&);
+    void PopPayloadAddedToMempool(const altintegration::VTB&);
+    void PopPayloadAddedToMempool(const altintegration::VbkBlock&);
+    void UpdatedPopTip(const CBlockIndex *, const altintegration::VbkBlock&, const altintegration::BtcBlock&);
 };
 
 CMainSignals& GetMainSignals();
@@ -7,17 +7,96 @@
 #define INTEGRATION_REFERENCE_BTC_BATCH_ADAPTER_HPP
 
 #include <dbwrapper.h>
+#include <hash.h>
 #include <veriblock/storage/batch_adaptor.hpp>
 
+#include <map>
+
 namespace VeriBlock {
 
-constexpr const char DB_BTC_BLOCK = 'Q';
+constexpr const char DB_BTC_BLOCK = 'A';
 constexpr const char DB_BTC_TIP = 'q';
-constexpr const char DB_VBK_BLOCK = 'W';
+constexpr const char DB_VBK_BLOCK = 'S';
 constexpr const char DB_VBK_TIP = 'w';
-constexpr const char DB_ALT_BLOCK = 'E';
+constexpr const char DB_ALT_BLOCK = 'D';
 constexpr const char DB_ALT_TIP = 'e';
 
+//! block indices keyed by hash only, as written by previous versions
+constexpr const char DB_BTC_BLOCK_LEGACY = 'Q';
+constexpr const char DB_VBK_BLOCK_LEGACY = 'W';
+constexpr const char DB_ALT_BLOCK_LEGACY = 'E';
+
+/**
+ * Key of BTC/VBK/ALT block index. Height is written big-endian, so that
+ * LevelDB keeps block indices of a tree sorted by height.
+ */
+template <typename hash_t>
+struct BlockIndexKey {
+    char prefix{0};
+    uint32_t height{0};
+    hash_t hash{};
+
+    BlockIndexKey() = default;
+    BlockIndexKey(char prefix_in, uint32_t height_in, const hash_t& hash_in) : prefix(prefix_in), height(height_in), hash(hash_in) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, prefix);
+        ser_writedata32be(s, height);
+        s << hash;
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        prefix = ser_readdata8(s);
+        height = ser_readdata32be(s);
+        s >> hash;
+    }
+};
+
+/**
+ * Remembers fingerprints of BTC/VBK/ALT block indices and tips as they were
+ * last written to disk. BatchAdapter consults it to skip entries which did not
+ * change since the previous flush.
+ *
+ * This saves disk writes only: SaveAllTrees still visits every block index,
+ * which is encoded and hashed here, so a flush costs O(all indices). The
+ * library does not report which indices it changed, so they can not be
+ * tracked from the outside.
+ */
+struct DirtyTracker {
+    //! returns true if entry differs from the one written last time, and remembers the new entry
+    bool setWritten(char type, const std::vector<uint8_t>& hash, const std::vector<uint8_t>& value)
+    {
+        CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+        hasher << value;
+        uint64_t fingerprint = hasher.GetCheapHash();
+
+        auto res = fingerprints_.emplace(std::make_pair(type, hash), fingerprint);
+        if (!res.second) {
+            if (res.first->second == fingerprint) {
+                return false;
+            }
+            res.first->second = fingerprint;
+        }
+        return true;
+    }
+
+    size_t size() const { return fingerprints_.size(); }
+
+    void merge(const DirtyTracker& other)
+    {
+        fingerprints_.insert(other.fingerprints_.begin(), other.fingerprints_.end());
+    }
+
+    void clear() { fingerprints_.clear(); }
+
+private:
+    std::map<std::pair<char, std::vector<uint8_t>>, uint64_t> fingerprints_;
+};
+
 struct BatchAdapter : public altintegration::BatchAdaptor {
     ~BatchAdapter() override = default;
 
@@ -34,51 +113,93 @@ struct BatchAdapter : public altintegration::BatchAdaptor {
         return std::make_pair(DB_ALT_TIP, "alttip");
     }
 
-    explicit BatchAdapter(CDBBatch& batch) : batch_(batch)
+    //! if tracker is not null, only entries which changed since last write are added to the batch
+    explicit BatchAdapter(CDBBatch& batch, DirtyTracker* tracker = nullptr) : batch_(batch), tracker_(tracker)
     {
     }
 
     bool writeBlock(const altintegration::BlockIndex<altintegration::BtcBlock>& value) override
     {
-        batch_.Write(std::make_pair(DB_BTC_BLOCK, getHash(value)), value);
+        write(DB_BTC_BLOCK, value);
         return true;
     };
     bool writeBlock(const altintegration::BlockIndex<altintegration::VbkBlock>& value) override
     {
-        batch_.Write(std::make_pair(DB_VBK_BLOCK, getHash(value)), value);
+        write(DB_VBK_BLOCK, value);
         return true;
     };
     bool writeBlock(const altintegration::BlockIndex<altintegration::AltBlock>& value) override
     {
-        batch_.Write(std::make_pair(DB_ALT_BLOCK, getHash(value)), value);
+        write(DB_ALT_BLOCK, value);
         return true;
     };
 
     bool writeTip(const altintegration::BlockIndex<altintegration::BtcBlock>& value) override
     {
-        batch_.Write(btctip(), getHash(value));
+        writeTip(btctip(), value);
         return true;
     };
     bool writeTip(const altintegration::BlockIndex<altintegration::VbkBlock>& value) override
     {
-        batch_.Write(vbktip(), getHash(value));
+        writeTip(vbktip(), value);
         return true;
     };
     bool writeTip(const altintegration::BlockIndex<altintegration::AltBlock>& value) override
     {
-        batch_.Write(alttip(), getHash(value));
+        writeTip(alttip(), value);
         return true;
     };
 
+    //! number of entries added to the batch
+    size_t written() const { return written_; }
+    //! number of entries skipped, because they were not changed since last write
+    size_t skipped() const { return skipped_; }
 
 private:
     CDBBatch& batch_;
+    DirtyTracker* tracker_;
+    size_t written_{0};
+    size_t skipped_{0};
 
     template <typename T>
     typename T::hash_t getHash(const T& c)
     {
         return c.getHash();
     }
+
+    template <typename T>
+    bool isDirty(char type, const T& hash, const std::vector<uint8_t>& value)
+    {
+        if (tracker_ == nullptr || tracker_->setWritten(type, std::vector<uint8_t>(hash.begin(), hash.end()), value)) {
+            ++written_;
+            return true;
+        }
+        ++skipped_;
+        return false;
+    }
+
+    template <typename Index>
+    void write(char type, const Index& value)
+    {
+        auto hash = getHash(value);
+        // Serialize() of a block index writes its toRaw() as a length prefixed
+        // vector, see serialize.h, so writing the vector itself produces the
+        // same bytes and lets them be fingerprinted without encoding twice
+        std::vector<uint8_t> raw = value.toRaw();
+        if (isDirty(type, hash, raw)) {
+            batch_.Write(BlockIndexKey<decltype(hash)>(type, value.getHeight(), hash), raw);
+        }
+    }
+
+    template <typename Index>
+    void writeTip(const std::pair<char, std::string>& key, const Index& value)
+    {
+        auto hash = getHash(value);
+        // tip is tracked by the hash it points to
+        if (isDirty(key.first, std::vector<uint8_t>{}, std::vector<uint8_t>(hash.begin(), hash.end()))) {
+            batch_.Write(key, hash);
+        }
+    }
 };
 
 } // namespace VeriBlock
@@ -7,8 +7,15 @@
 #define INTEGRATION_REFERENCE_BTC_CURSOR_HPP
 
 #include "dbwrapper.h"
+#include <clientversion.h>
+#include <serialize.h>
+#include <span.h>
+#include <streams.h>
 #include <veriblock/storage/cursor.hpp>
 
+#include <algorithm>
+#include <ios>
+
 
 namespace VeriBlock {
 
@@ -39,7 +46,7 @@ struct Cursor : public altintegration::Cursor<std::vector<uint8_t>, std::vector<
      */
     void seekToLast()
     {
-        assert(false && "not implemented");
+        iter_->SeekToLast();
     };
 
     /**
@@ -64,7 +71,7 @@ struct Cursor : public altintegration::Cursor<std::vector<uint8_t>, std::vector<
      */
     void prev()
     {
-        assert(false && "not implemented");
+        iter_->Prev();
     };
 
     /**
@@ -72,11 +79,8 @@ struct Cursor : public altintegration::Cursor<std::vector<uint8_t>, std::vector<
      */
     std::vector<uint8_t> key() const
     {
-        std::vector<uint8_t> v;
-        if (!iter_->GetKey(v)) {
-            return {};
-        }
-        return v;
+        auto view = keyView();
+        return std::vector<uint8_t>(view.begin(), view.end());
     };
 
     /**
@@ -85,6 +89,10 @@ struct Cursor : public altintegration::Cursor<std::vector<uint8_t>, std::vector<
      */
     std::vector<uint8_t> value() const
     {
+        Span<const uint8_t> view;
+        if (valueView(view)) {
+            return std::vector<uint8_t>(view.begin(), view.end());
+        }
         std::vector<uint8_t> v;
         if (!iter_->GetValue(v)) {
             return {};
@@ -92,7 +100,51 @@ struct Cursor : public altintegration::Cursor<std::vector<uint8_t>, std::vector<
         return v;
     };
 
+    /**
+     * Key pointed by this cursor, without copying. Valid until the cursor is
+     * moved. Empty on error.
+     */
+    Span<const uint8_t> keyView() const
+    {
+        Span<const uint8_t> view;
+        if (!readVector(iter_->GetKeyView(), view)) {
+            return {};
+        }
+        return view;
+    };
+
+    /**
+     * Value pointed by this cursor, without copying. Valid until the cursor
+     * is moved. Returns false on error, or if the database obfuscates values.
+     */
+    bool valueView(Span<const uint8_t>& view) const
+    {
+        Span<const uint8_t> raw;
+        return iter_->GetValueView(raw) && readVector(raw, view);
+    };
+
 private:
+    //! keys and values are stored as serialized vectors: compact size, then bytes
+    static bool readVector(Span<const uint8_t> raw, Span<const uint8_t>& out)
+    {
+        // compact size takes at most 9 bytes, so only they are copied into the stream
+        const char* begin = reinterpret_cast<const char*>(raw.data());
+        const std::ptrdiff_t prefixSize = std::min<std::ptrdiff_t>(raw.size(), 9);
+        CDataStream prefix(begin, begin + prefixSize, SER_DISK, CLIENT_VERSION);
+        uint64_t size;
+        try {
+            size = ReadCompactSize(prefix);
+        } catch (const std::ios_base::failure&) {
+            return false;
+        }
+        const std::ptrdiff_t offset = prefixSize - (std::ptrdiff_t)prefix.size();
+        if ((uint64_t)(raw.size() - offset) != size) {
+            return false;
+        }
+        out = raw.subspan(offset);
+        return true;
+    }
+
     std::shared_ptr<CDBIterator> iter_;
 };
 
@@ -6,55 +6,192 @@
 #ifndef INTEGRATION_REFERENCE_BTC_REPOSITORY_HPP
 #define INTEGRATION_REFERENCE_BTC_REPOSITORY_HPP
 
+#include <dbwrapper.h>
+#include <optional.h>
+#include <sync.h>
 #include <veriblock/storage/repository.hpp>
 
+#include <map>
+
 #include "batch.hpp"
 #include "cursor.hpp"
 
 namespace VeriBlock {
 
+//! pending writes of a write-behind Repository are committed without sync above this size
+static const size_t MAX_POP_REPOSITORY_PENDING_SIZE = 16 << 20;
+
+/**
+ * In write-behind mode put() and remove() are queued in memory and read back
+ * from there. Queued writes are group committed without sync once they grow
+ * over MAX_POP_REPOSITORY_PENDING_SIZE, and with the block index batch by
+ * flush(), which is called from FlushStateToDisk. A sync write commits all
+ * preceding writes too, so flush() is the durability boundary.
+ *
+ * Queued writes leave memory only after they are written. If a group commit
+ * fails, newBatch() and newCursor() throw dbwrapper_error, as CDBWrapper does
+ * for a failed write.
+ *
+ * Keys not found in db are read from legacydb, if given, see SetPop.
+ */
 struct Repository : public altintegration::Repository
 {
     using base = altintegration::Repository;
 
     ~Repository() = default;
 
-    Repository(CDBWrapper& db) : db_(db) {}
+    Repository(CDBWrapper& db, bool writeBehind = false, CDBWrapper* legacydb = nullptr) : db_(db), writeBehind_(writeBehind), legacydb_(legacydb) {}
 
     bool remove(const key_t& id)
     {
-        return db_.Erase(id, true);
+        if (legacydb_ && !legacydb_->Erase(id)) {
+            return false;
+        }
+        if (!writeBehind_) {
+            return db_.Erase(id, true);
+        }
+        LOCK(cs_pending_);
+        pendingSize_ += id.size();
+        pending_[id] = nullopt;
+        return pendingSize_ <= MAX_POP_REPOSITORY_PENDING_SIZE || writePending();
     };
 
     //! returns true if operation is successful, false otherwise
     bool put(const key_t& key, const value_t& value)
     {
-        return db_.Write(key, value, true);
+        if (!writeBehind_) {
+            return db_.Write(key, value, true);
+        }
+        LOCK(cs_pending_);
+        pendingSize_ += key.size() + value.size();
+        pending_[key] = value;
+        return pendingSize_ <= MAX_POP_REPOSITORY_PENDING_SIZE || writePending();
     }
 
     //! returns true if key exists, false otherwise/on error
     bool get(const key_t& key, value_t* value) const
     {
-        if (value) {
-            return db_.Read(key, *value);
-        } else {
-            return db_.Exists(key);
+        {
+            LOCK(cs_pending_);
+            auto it = pending_.find(key);
+            if (it != pending_.end()) {
+                if (!it->second) {
+                    return false;
+                }
+                if (value) {
+                    *value = *it->second;
+                }
+                return true;
+            }
         }
+
+        if (value ? db_.Read(key, *value) : db_.Exists(key)) {
+            return true;
+        }
+        // written before PoP data was moved into db_
+        if (legacydb_) {
+            return value ? legacydb_->Read(key, *value) : legacydb_->Exists(key);
+        }
+        return false;
     }
 
     std::unique_ptr<batch_t> newBatch()
     {
+        // batch must not be overwritten by older queued writes
+        LOCK(cs_pending_);
+        if (!writePending()) {
+            throw dbwrapper_error("Failed to write queued PoP storage writes");
+        }
         CDBBatch batch(db_);
         return MakeUnique<Batch>(db_, std::move(batch));
     }
 
     std::shared_ptr<cursor_t> newCursor() const
     {
+        // cursor reads the database only
+        LOCK(cs_pending_);
+        if (!writePending()) {
+            throw dbwrapper_error("Failed to write queued PoP storage writes");
+        }
         return std::make_shared<Cursor>(db_.NewIterator());
     }
 
+    //! adds queued writes to batch, which is written with sync. They stay queued until flushed() is called
+    void flush(CDBBatch& batch)
+    {
+        LOCK(cs_pending_);
+        addPending(batch);
+        flushing_ = pending_;
+    }
+
+    //! drops writes added to batch by flush() from the queue, call once the batch is written
+    void flushed()
+    {
+        LOCK(cs_pending_);
+        for (const auto& it : flushing_) {
+            auto pending = pending_.find(it.first);
+            // keep the key queued if it was written again since flush()
+            if (pending != pending_.end() && pending->second == it.second) {
+                pending_.erase(pending);
+            }
+        }
+        flushing_.clear();
+        updatePendingSize();
+    }
+
+protected:
+    //! writes batch of queued writes, virtual for testing
+    virtual bool writeBatch(CDBBatch& batch) const
+    {
+        return db_.WriteBatch(batch, false);
+    }
+
 private:
+    void addPending(CDBBatch& batch) const EXCLUSIVE_LOCKS_REQUIRED(cs_pending_)
+    {
+        for (const auto& it : pending_) {
+            if (it.second) {
+                batch.Write(it.first, *it.second);
+            } else {
+                batch.Erase(it.first);
+            }
+        }
+    }
+
+    void updatePendingSize() const EXCLUSIVE_LOCKS_REQUIRED(cs_pending_)
+    {
+        pendingSize_ = 0;
+        for (const auto& it : pending_) {
+            pendingSize_ += it.first.size() + (it.second ? it.second->size() : 0);
+        }
+    }
+
+    //! commits queued writes without sync, they stay queued if the write fails
+    bool writePending() const EXCLUSIVE_LOCKS_REQUIRED(cs_pending_)
+    {
+        if (pending_.empty()) {
+            return true;
+        }
+        CDBBatch batch(db_);
+        addPending(batch);
+        if (!writeBatch(batch)) {
+            return false;
+        }
+        pending_.clear();
+        pendingSize_ = 0;
+        return true;
+    }
+
     CDBWrapper& db_;
+    const bool writeBehind_;
+    CDBWrapper* const legacydb_;
+
+    mutable Mutex cs_pending_;
+    //! queued writes, nullopt for removed keys
+    mutable std::map<key_t, Optional<value_t>> pending_ GUARDED_BY(cs_pending_);
+    mutable size_t pendingSize_ GUARDED_BY(cs_pending_){0};
+    //! queued writes added to the batch of the last flush()
+    std::map<key_t, Optional<value_t>> flushing_ GUARDED_BY(cs_pending_);
 };
 
 } // namespace VeriBlock
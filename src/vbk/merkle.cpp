@@ -55,32 +55,29 @@ uint256 makeTopLevelRoot(int height, const KeystoneArray& keystones, const uint2
 
 const CBlockIndex* getPreviousKeystone(const CBlockIndex& block)
 {
-    const CBlockIndex* pblockWalk = &block;
-    do {
-        pblockWalk = pblockWalk->pprev;
-    } while (pblockWalk != nullptr && !isKeystone(*pblockWalk));
+    if (block.nHeight <= 0) {
+        return nullptr;
+    }
 
-    return pblockWalk;
+    // highest keystone below the block
+    const int keystoneInterval = GetKeystoneInterval();
+    return block.GetAncestor(((block.nHeight - 1) / keystoneInterval) * keystoneInterval);
 }
 
 KeystoneArray getKeystoneHashesForTheNextBlock(const CBlockIndex* pindexPrev)
 {
-    const CBlockIndex* pwalk = pindexPrev;
-
     KeystoneArray keystones;
-    auto it = keystones.begin();
-    auto end = keystones.end();
-    while (it != end) {
-        if (pwalk == nullptr) {
-            break;
-        }
-
-        if (isKeystone(*pwalk)) {
-            *it = pwalk->GetBlockHash();
-            ++it;
-        }
+    if (pindexPrev == nullptr) {
+        return keystones;
+    }
 
-        pwalk = getPreviousKeystone(*pwalk);
+    // keystones are the most recent blocks at heights which are multiples of
+    // keystone interval, starting with pindexPrev itself
+    const int keystoneInterval = GetKeystoneInterval();
+    const CBlockIndex* pwalk = pindexPrev->GetAncestor((pindexPrev->nHeight / keystoneInterval) * keystoneInterval);
+    for (auto it = keystones.begin(); it != keystones.end() && pwalk != nullptr; ++it) {
+        *it = pwalk->GetBlockHash();
+        pwalk = pwalk->GetAncestor(pwalk->nHeight - keystoneInterval);
     }
     return keystones;
 }
@@ -150,8 +147,7 @@ CTxOut addPopDataRootIntoCoinbaseCommitment(const CBlock& block)
 
 bool isKeystone(const CBlockIndex& block)
 {
-    auto keystoneInterval = VeriBlock::GetPop().config->alt->getKeystoneInterval();
-    return (block.nHeight % keystoneInterval) == 0;
+    return (block.nHeight % GetKeystoneInterval()) == 0;
 }
 
 } // namespace VeriBlock
@@ -7,6 +7,10 @@
 #include <veriblock/entities/vbkblock.hpp>
 #include <veriblock/entities/vtb.hpp>
 #include "vbk/p2p_sync.hpp"
+#include "vbk/pop_stats.hpp"
+
+#include <algorithm>
+#include <unordered_map>
 
 namespace VeriBlock {
 namespace p2p {
@@ -14,64 +18,236 @@ namespace p2p {
 static std::map<NodeId, std::shared_ptr<PopDataNodeState>> mapPopDataNodeState;
 
 template <>
-std::map<altintegration::ATV::id_t, PopP2PState>& PopDataNodeState::getMap<altintegration::ATV>()
+PopP2PStateCache<altintegration::ATV::id_t>& PopDataNodeState::getMap<altintegration::ATV>()
 {
     return atv_state;
 }
 
 template <>
-std::map<altintegration::VTB::id_t, PopP2PState>& PopDataNodeState::getMap<altintegration::VTB>()
+PopP2PStateCache<altintegration::VTB::id_t>& PopDataNodeState::getMap<altintegration::VTB>()
 {
     return vtb_state;
 }
 
 template <>
-std::map<altintegration::VbkBlock::id_t, PopP2PState>& PopDataNodeState::getMap<altintegration::VbkBlock>()
+PopP2PStateCache<altintegration::VbkBlock::id_t>& PopDataNodeState::getMap<altintegration::VbkBlock>()
 {
     return vbk_blocks_state;
 }
 
-PopDataNodeState& getPopDataNodeState(const NodeId& id) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+template <>
+std::set<altintegration::ATV::id_t>& PopDataNodeState::getInventoryToSend<altintegration::ATV>()
 {
-    AssertLockHeld(cs_main);
+    return atv_to_send;
+}
+
+template <>
+std::set<altintegration::VTB::id_t>& PopDataNodeState::getInventoryToSend<altintegration::VTB>()
+{
+    return vtb_to_send;
+}
+
+template <>
+std::set<altintegration::VbkBlock::id_t>& PopDataNodeState::getInventoryToSend<altintegration::VbkBlock>()
+{
+    return vbk_blocks_to_send;
+}
+
+PopDataNodeState& getPopDataNodeState(const NodeId& id) EXCLUSIVE_LOCKS_REQUIRED(cs_popmempool)
+{
+    AssertLockHeld(cs_popmempool);
     std::shared_ptr<PopDataNodeState>& val = mapPopDataNodeState[id];
     if (val == nullptr) {
-        mapPopDataNodeState[id] = std::make_shared<PopDataNodeState>();
-        val = mapPopDataNodeState[id];
+        val = std::make_shared<PopDataNodeState>();
     }
     return *val;
 }
 
-void erasePopDataNodeState(const NodeId& id) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+void erasePopDataNodeState(const NodeId& id)
 {
-    AssertLockHeld(cs_main);
+    LOCK(cs_popmempool);
     mapPopDataNodeState.erase(id);
 }
 
 template <typename pop_t>
-bool processGetPopData(CNode* node, CConnman* connman, CDataStream& vRecv, altintegration::MemPool& pop_mempool) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+void erasePopDataFromNodeStates(const std::vector<typename pop_t::id_t>& ids) EXCLUSIVE_LOCKS_REQUIRED(cs_popmempool)
 {
-    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_popmempool);
+    for (auto& el : mapPopDataNodeState) {
+        PopDataNodeState& state = *el.second;
+        for (const auto& id : ids) {
+            state.getMap<pop_t>().erase(id);
+            state.getInventoryToSend<pop_t>().erase(id);
+        }
+    }
+}
+
+template void erasePopDataFromNodeStates<altintegration::ATV>(const std::vector<altintegration::ATV::id_t>& ids);
+template void erasePopDataFromNodeStates<altintegration::VTB>(const std::vector<altintegration::VTB::id_t>& ids);
+template void erasePopDataFromNodeStates<altintegration::VbkBlock>(const std::vector<altintegration::VbkBlock::id_t>& ids);
+
+template <typename pop_t>
+static std::vector<typename pop_t::id_t> getIds(const std::vector<pop_t>& payloads)
+{
+    std::vector<typename pop_t::id_t> ids;
+    ids.reserve(payloads.size());
+    for (const auto& p : payloads) {
+        ids.push_back(p.getId());
+    }
+    return ids;
+}
+
+void erasePopDataFromNodeStates(const altintegration::PopData& popData) EXCLUSIVE_LOCKS_REQUIRED(cs_popmempool)
+{
+    erasePopDataFromNodeStates<altintegration::VbkBlock>(getIds(popData.context));
+    erasePopDataFromNodeStates<altintegration::VTB>(getIds(popData.vtbs));
+    erasePopDataFromNodeStates<altintegration::ATV>(getIds(popData.atvs));
+}
+
+size_t getPopDataNodeStateMemoryUsage(const NodeId& id)
+{
+    LOCK(cs_popmempool);
+    auto it = mapPopDataNodeState.find(id);
+    if (it == mapPopDataNodeState.end()) {
+        return 0;
+    }
+    return it->second->DynamicMemoryUsage();
+}
+
+template <typename pop_t>
+void offerPopDataToAllNodes(const pop_t& p)
+{
+    LOCK(cs_popmempool);
+    for (auto& el : mapPopDataNodeState) {
+        el.second->getInventoryToSend<pop_t>().insert(p.getId());
+    }
+}
+
+template void offerPopDataToAllNodes<altintegration::ATV>(const altintegration::ATV& p);
+template void offerPopDataToAllNodes<altintegration::VTB>(const altintegration::VTB& p);
+template void offerPopDataToAllNodes<altintegration::VbkBlock>(const altintegration::VbkBlock& p);
+
+template <typename pop_t>
+static void queuePopMempool(PopDataNodeState& state, const altintegration::MemPool& pop_mempool) EXCLUSIVE_LOCKS_REQUIRED(cs_popmempool)
+{
+    auto& to_send = state.getInventoryToSend<pop_t>();
+    for (const auto& el : pop_mempool.getMap<pop_t>()) {
+        to_send.insert(el.first);
+    }
+}
+
+template <typename pop_t>
+static void sendQueuedPopData(CNode* node, CConnman* connman, const CNetMsgMaker& msgMaker, PopDataNodeState& state) EXCLUSIVE_LOCKS_REQUIRED(cs_popmempool)
+{
+    auto& to_send = state.getInventoryToSend<pop_t>();
+    std::vector<std::vector<uint8_t>> hashes;
+    hashes.reserve(std::min<size_t>(to_send.size(), POP_INVENTORY_BROADCAST_MAX));
+
+    auto it = to_send.begin();
+    while (it != to_send.end() && hashes.size() < POP_INVENTORY_BROADCAST_MAX) {
+        auto id = it->asVector();
+        it = to_send.erase(it);
+        if (state.filterKnown.contains(id)) {
+            continue;
+        }
+        state.filterKnown.insert(id);
+        hashes.push_back(std::move(id));
+    }
+
+    if (!hashes.empty()) {
+        connman->PushMessage(node, msgMaker.Make(offer_prefix + pop_t::name(), hashes));
+    }
+}
+
+void sendPopInventory(CNode* node, CConnman* connman, const CNetMsgMaker& msgMaker, std::chrono::microseconds current_time)
+{
+    LOCK(cs_popmempool);
+    auto& state = getPopDataNodeState(node->GetId());
+
+    if (!state.fMempoolQueued) {
+        // a new peer gets whatever is in PoP mempool once, further payloads
+        // are queued as they are accepted
+        const auto& pop_mempool = *VeriBlock::GetPop().mempool;
+        queuePopMempool<altintegration::VbkBlock>(state, pop_mempool);
+        queuePopMempool<altintegration::VTB>(state, pop_mempool);
+        queuePopMempool<altintegration::ATV>(state, pop_mempool);
+        state.fMempoolQueued = true;
+    }
+
+    bool fSendTrickle = node->HasPermission(PF_NOBAN);
+    if (state.nNextInvSend < current_time) {
+        fSendTrickle = true;
+        if (node->fInbound) {
+            state.nNextInvSend = std::chrono::microseconds{connman->PoissonNextSendInbound(current_time.count(), POP_INVENTORY_BROADCAST_INTERVAL)};
+        } else {
+            state.nNextInvSend = PoissonNextSend(current_time, std::chrono::seconds{POP_INVENTORY_BROADCAST_INTERVAL >> 1});
+        }
+    }
+
+    if (!fSendTrickle) {
+        return;
+    }
+
+    // context goes first, so that peers can connect payloads which refer to it
+    sendQueuedPopData<altintegration::VbkBlock>(node, connman, msgMaker, state);
+    sendQueuedPopData<altintegration::VTB>(node, connman, msgMaker, state);
+    sendQueuedPopData<altintegration::ATV>(node, connman, msgMaker, state);
+}
+
+namespace {
+
+//! DoS score for peers that break PoP relay protocol
+const int POP_MISBEHAVING_SCORE = 20;
+
+/**
+ * Result of processing a PoP message. Peers are punished after
+ * cs_popmempool is released, because Misbehaving requires cs_main, which
+ * has to be taken first.
+ */
+struct PopMessageResult {
+    bool ok{true};
+    std::string misbehaving{};
+
+    static PopMessageResult Misbehaving(std::string reason)
+    {
+        PopMessageResult res;
+        res.ok = false;
+        res.misbehaving = std::move(reason);
+        return res;
+    }
+};
+
+} // namespace
+
+template <typename pop_t>
+PopMessageResult processGetPopData(CNode* node, CConnman* connman, CDataStream& vRecv, altintegration::MemPool& pop_mempool) EXCLUSIVE_LOCKS_REQUIRED(cs_popmempool)
+{
+    AssertLockHeld(cs_popmempool);
     std::vector<std::vector<uint8_t>> requested_data;
     vRecv >> requested_data;
 
     if (requested_data.size() > MAX_POP_DATA_SENDING_AMOUNT) {
         LogPrint(BCLog::NET, "peer %d send oversized message getdata size() = %u \n", node->GetId(), requested_data.size());
-        Misbehaving(node->GetId(), 20, strprintf("message getdata size() = %u", requested_data.size()));
-        return false;
+        return PopMessageResult::Misbehaving(strprintf("message getdata size() = %u", requested_data.size()));
     }
 
-    auto& pop_state_map = getPopDataNodeState(node->GetId()).getMap<pop_t>();
+    auto& node_state = getPopDataNodeState(node->GetId());
+    auto& pop_state_map = node_state.getMap<pop_t>();
 
     const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
+    size_t new_counters = 0;
     for (const auto& data_hash : requested_data) {
-        PopP2PState& pop_state = pop_state_map[data_hash];
+        if (!pop_state_map.contains(data_hash) && ++new_counters > MAX_POP_RELAY_NEW_COUNTERS) {
+            LogPrint(BCLog::NET, "peer %d is flooding pop data %s requests\n", node->GetId(), pop_t::name());
+            return PopMessageResult::Misbehaving(strprintf("peer %d is flooding pop data %s requests", node->GetId(), pop_t::name()));
+        }
+        PopP2PState& pop_state = pop_state_map.get(data_hash);
         uint32_t ddosPreventionCounter = pop_state.known_pop_data++;
+        node_state.filterKnown.insert(data_hash);
 
         if (ddosPreventionCounter > MAX_POP_MESSAGE_SENDING_COUNT) {
             LogPrint(BCLog::NET, "peer %d is spamming pop data %s \n", node->GetId(), pop_t::name());
-            Misbehaving(node->GetId(), 20, strprintf("peer %d is spamming pop data %s", node->GetId(), pop_t::name()));
-            return false;
+            return PopMessageResult::Misbehaving(strprintf("peer %d is spamming pop data %s", node->GetId(), pop_t::name()));
         }
 
         const auto* data = pop_mempool.get<pop_t>(data_hash);
@@ -80,37 +256,43 @@ bool processGetPopData(CNode* node, CConnman* connman, CDataStream& vRecv, altin
         }
     }
 
-    return true;
+    return {};
 }
 
 template <typename pop_t>
-bool processOfferPopData(CNode* node, CConnman* connman, CDataStream& vRecv, altintegration::MemPool& pop_mempool) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+PopMessageResult processOfferPopData(CNode* node, CConnman* connman, CDataStream& vRecv, altintegration::MemPool& pop_mempool) EXCLUSIVE_LOCKS_REQUIRED(cs_popmempool)
 {
-    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_popmempool);
     LogPrint(BCLog::NET, "received offered pop data: %s, bytes size: %d\n", pop_t::name(), vRecv.size());
     std::vector<std::vector<uint8_t>> offered_data;
     vRecv >> offered_data;
 
     if (offered_data.size() > MAX_POP_DATA_SENDING_AMOUNT) {
         LogPrint(BCLog::NET, "peer %d send oversized message getdata size() = %u \n", node->GetId(), offered_data.size());
-        Misbehaving(node->GetId(), 20, strprintf("message getdata size() = %u", offered_data.size()));
-        return false;
+        return PopMessageResult::Misbehaving(strprintf("message getdata size() = %u", offered_data.size()));
     }
 
-    auto& pop_state_map = getPopDataNodeState(node->GetId()).getMap<pop_t>();
+    auto& node_state = getPopDataNodeState(node->GetId());
+    auto& pop_state_map = node_state.getMap<pop_t>();
 
     std::vector<std::vector<uint8_t>> requested_data;
     const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
+    size_t new_counters = 0;
     for (const auto& data_hash : offered_data) {
-        PopP2PState& pop_state = pop_state_map[data_hash];
+        if (!pop_state_map.contains(data_hash) && ++new_counters > MAX_POP_RELAY_NEW_COUNTERS) {
+            LogPrint(BCLog::NET, "peer %d is flooding pop data %s offers\n", node->GetId(), pop_t::name());
+            return PopMessageResult::Misbehaving(strprintf("peer %d is flooding pop data %s offers", node->GetId(), pop_t::name()));
+        }
+        PopP2PState& pop_state = pop_state_map.get(data_hash);
         uint32_t ddosPreventionCounter = pop_state.requested_pop_data++;
+        node_state.filterKnown.insert(data_hash);
 
         if (!pop_mempool.get<pop_t>(data_hash)) {
+            node_state.filterRequested.insert(data_hash);
             requested_data.push_back(data_hash);
         } else if (ddosPreventionCounter > MAX_POP_MESSAGE_SENDING_COUNT) {
             LogPrint(BCLog::NET, "peer %d is spamming pop data %s \n", node->GetId(), pop_t::name());
-            Misbehaving(node->GetId(), 20, strprintf("peer %d is spamming pop data %s", node->GetId(), pop_t::name()));
-            return false;
+            return PopMessageResult::Misbehaving(strprintf("peer %d is spamming pop data %s", node->GetId(), pop_t::name()));
         }
     }
 
@@ -118,102 +300,126 @@ bool processOfferPopData(CNode* node, CConnman* connman, CDataStream& vRecv, alt
         connman->PushMessage(node, msgMaker.Make(get_prefix + pop_t::name(), requested_data));
     }
 
-    return true;
+    return {};
 }
 
 template <typename pop_t>
-bool processPopData(CNode* node, CDataStream& vRecv, altintegration::MemPool& pop_mempool) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+PopMessageResult processPopData(CNode* node, CDataStream& vRecv, altintegration::MemPool& pop_mempool) EXCLUSIVE_LOCKS_REQUIRED(cs_main, cs_popmempool)
 {
     AssertLockHeld(cs_main);
+    AssertLockHeld(cs_popmempool);
     LogPrint(BCLog::NET, "received pop data: %s, bytes size: %d\n", pop_t::name(), vRecv.size());
     pop_t data;
     vRecv >> data;
 
-    auto& pop_state_map = getPopDataNodeState(node->GetId()).getMap<pop_t>();
-    PopP2PState& pop_state = pop_state_map[data.getId()];
+    auto& node_state = getPopDataNodeState(node->GetId());
+    const auto data_hash = data.getId().asVector();
 
-    if (pop_state.requested_pop_data == 0) {
+    if (!node_state.filterRequested.contains(data_hash)) {
         LogPrint(BCLog::NET, "peer %d send pop data %s that has not been requested \n", node->GetId(), pop_t::name());
-        Misbehaving(node->GetId(), 20, strprintf("peer %d send pop data %s that has not been requested", node->GetId(), pop_t::name()));
-        return false;
+        return PopMessageResult::Misbehaving(strprintf("peer %d send pop data %s that has not been requested", node->GetId(), pop_t::name()));
     }
 
+    PopP2PState& pop_state = node_state.getMap<pop_t>().get(data.getId());
     uint32_t ddosPreventionCounter = pop_state.requested_pop_data++;
 
     if (ddosPreventionCounter > MAX_POP_MESSAGE_SENDING_COUNT) {
         LogPrint(BCLog::NET, "peer %d is spaming pop data %s\n", node->GetId(), pop_t::name());
-        Misbehaving(node->GetId(), 20, strprintf("peer %d is spamming pop data %s", node->GetId(), pop_t::name()));
-        return false;
+        return PopMessageResult::Misbehaving(strprintf("peer %d is spamming pop data %s", node->GetId(), pop_t::name()));
     }
 
     altintegration::ValidationState state;
-    if (!pop_mempool.submit(data, state, false)) {
+    bool submitted;
+    {
+        PopOperationTimer timer(PopOperation::MEMPOOL_SUBMIT);
+        submitted = pop_mempool.submit(data, state, false);
+    }
+    if (!submitted) {
         LogPrint(BCLog::NET, "peer %d sent invalid pop data: %s\n", node->GetId(), state.toString());
-        Misbehaving(node->GetId(), 20, strprintf("invalid pop data getdata, reason: %s", state.toString()));
-        return false;
+        return PopMessageResult::Misbehaving(strprintf("invalid pop data getdata, reason: %s", state.toString()));
     }
 
-    return true;
+    return {};
 }
 
-int processPopData(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman* connman)
+static int punish(CNode* node, const PopMessageResult& result)
 {
-    auto& pop_mempool = *VeriBlock::GetPop().mempool;
-
-    // process Pop Data
-    if (strCommand == altintegration::ATV::name()) {
-        LOCK(cs_main);
-        return processPopData<altintegration::ATV>(pfrom, vRecv, pop_mempool);
-    }
-
-    if (strCommand == altintegration::VTB::name()) {
+    if (!result.misbehaving.empty()) {
         LOCK(cs_main);
-        return processPopData<altintegration::VTB>(pfrom, vRecv, pop_mempool);
+        Misbehaving(node->GetId(), POP_MISBEHAVING_SCORE, result.misbehaving);
     }
+    return result.ok;
+}
 
-    if (strCommand == altintegration::VbkBlock::name()) {
-        LOCK(cs_main);
-        return processPopData<altintegration::VbkBlock>(pfrom, vRecv, pop_mempool);
+// payloads are validated against the alt tree, so they need cs_main
+template <typename pop_t>
+int handlePopData(CNode* pfrom, CDataStream& vRecv, CConnman* connman)
+{
+    PopMessageResult result;
+    {
+        LOCK2(cs_main, cs_popmempool);
+        result = processPopData<pop_t>(pfrom, vRecv, *VeriBlock::GetPop().mempool);
     }
-    //----------------------
+    return punish(pfrom, result);
+}
 
-    // offer Pop Data
-    if (strCommand == offer_prefix + altintegration::ATV::name()) {
-        LOCK(cs_main);
-        return processOfferPopData<altintegration::ATV>(pfrom, connman, vRecv, pop_mempool);
+// offer and get messages only touch PoP mempool and per-peer state
+template <typename pop_t>
+int handleOfferPopData(CNode* pfrom, CDataStream& vRecv, CConnman* connman)
+{
+    PopMessageResult result;
+    {
+        LOCK(cs_popmempool);
+        result = processOfferPopData<pop_t>(pfrom, connman, vRecv, *VeriBlock::GetPop().mempool);
     }
+    return punish(pfrom, result);
+}
 
-    if (strCommand == offer_prefix + altintegration::VTB::name()) {
-        LOCK(cs_main);
-        return processOfferPopData<altintegration::VTB>(pfrom, connman, vRecv, pop_mempool);
+template <typename pop_t>
+int handleGetPopData(CNode* pfrom, CDataStream& vRecv, CConnman* connman)
+{
+    PopMessageResult result;
+    {
+        LOCK(cs_popmempool);
+        result = processGetPopData<pop_t>(pfrom, connman, vRecv, *VeriBlock::GetPop().mempool);
     }
+    return punish(pfrom, result);
+}
 
-    if (strCommand == offer_prefix + altintegration::VbkBlock::name()) {
-        LOCK(cs_main);
-        return processOfferPopData<altintegration::VbkBlock>(pfrom, connman, vRecv, pop_mempool);
-    }
-    //-----------------
+using PopMessageHandler = int (*)(CNode* pfrom, CDataStream& vRecv, CConnman* connman);
 
-    // get Pop Data
-    if (strCommand == get_prefix + altintegration::ATV::name()) {
-        LOCK(cs_main);
-        return processGetPopData<altintegration::ATV>(pfrom, connman, vRecv, pop_mempool);
-    }
+template <typename pop_t>
+void addPopMessageHandlers(std::unordered_map<std::string, PopMessageHandler>& handlers)
+{
+    handlers.emplace(pop_t::name(), &handlePopData<pop_t>);
+    handlers.emplace(offer_prefix + pop_t::name(), &handleOfferPopData<pop_t>);
+    handlers.emplace(get_prefix + pop_t::name(), &handleGetPopData<pop_t>);
+}
 
-    if (strCommand == get_prefix + altintegration::VTB::name()) {
-        LOCK(cs_main);
-        return processGetPopData<altintegration::VTB>(pfrom, connman, vRecv, pop_mempool);
-    }
+static const std::unordered_map<std::string, PopMessageHandler>& getPopMessageHandlers()
+{
+    static const std::unordered_map<std::string, PopMessageHandler> handlers = []() {
+        std::unordered_map<std::string, PopMessageHandler> ret;
+        addPopMessageHandlers<altintegration::ATV>(ret);
+        addPopMessageHandlers<altintegration::VTB>(ret);
+        addPopMessageHandlers<altintegration::VbkBlock>(ret);
+        return ret;
+    }();
+    return handlers;
+}
 
-    if (strCommand == get_prefix + altintegration::VbkBlock::name()) {
-        LOCK(cs_main);
-        return processGetPopData<altintegration::VbkBlock>(pfrom, connman, vRecv, pop_mempool);
+int processPopData(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman* connman)
+{
+    const auto& handlers = getPopMessageHandlers();
+    auto it = handlers.find(strCommand);
+    if (it == handlers.end()) {
+        return -1;
     }
-
-    return -1;
+    PopOperationTimer timer(PopOperation::P2P_MESSAGE);
+    return it->second(pfrom, vRecv, connman);
 }
 
 
 } // namespace p2p
 
-} // namespace VeriBlock
\ No newline at end of file
+} // namespace VeriBlock
@@ -6,8 +6,12 @@
 #ifndef BITCOIN_SRC_VBK_P2P_SYNC_HPP
 #define BITCOIN_SRC_VBK_P2P_SYNC_HPP
 
+#include <bloom.h>
 #include <chainparams.h>
+#include <list>
 #include <map>
+#include <memusage.h>
+#include <set>
 #include <net_processing.h>
 #include <netmessagemaker.h>
 #include <node/context.h>
@@ -19,27 +23,127 @@ namespace VeriBlock {
 
 namespace p2p {
 
+const static std::string get_prefix = "g";
+const static std::string offer_prefix = "of";
+
+const static uint32_t MAX_POP_DATA_SENDING_AMOUNT = MAX_INV_SZ;
+const static uint32_t MAX_POP_MESSAGE_SENDING_COUNT = 30;
+
+//! Number of DDoS prevention counters kept per peer for each payload type
+const static size_t MAX_POP_RELAY_COUNTERS = 1000;
+//! Number of new DDoS prevention counters a single message may add. Half of
+//! the counters, so that one message can not evict the ones of the previous.
+const static size_t MAX_POP_RELAY_NEW_COUNTERS = MAX_POP_RELAY_COUNTERS / 2;
+//! Average delay between PoP inventory announcements, in seconds
+const static unsigned int POP_INVENTORY_BROADCAST_INTERVAL = 5;
+//! Maximum number of payloads of a type announced to a peer at once
+const static unsigned int POP_INVENTORY_BROADCAST_MAX = MAX_POP_RELAY_NEW_COUNTERS;
+//! Payload ids a peer is known to have, or that we already offered to it
+const static unsigned int POP_KNOWN_FILTER_SIZE = 20000;
+//! Payload ids we requested from a peer; one full offer has to fit
+const static unsigned int POP_REQUESTED_FILTER_SIZE = MAX_POP_DATA_SENDING_AMOUNT;
+
 struct PopP2PState {
     uint32_t known_pop_data{0};
-    uint32_t offered_pop_data{0};
     uint32_t requested_pop_data{0};
 };
 
+// Least recently used DDoS prevention counters, bounded by capacity
+template <typename id_t>
+class PopP2PStateCache
+{
+public:
+    explicit PopP2PStateCache(size_t capacity) : capacity_(capacity) {}
+
+    PopP2PState& get(const id_t& id)
+    {
+        auto it = index_.find(id);
+        if (it != index_.end()) {
+            items_.splice(items_.begin(), items_, it->second);
+            return it->second->second;
+        }
+
+        if (items_.size() >= capacity_) {
+            index_.erase(items_.back().first);
+            items_.pop_back();
+        }
+        items_.emplace_front(id, PopP2PState{});
+        index_.emplace(id, items_.begin());
+        return items_.front().second;
+    }
+
+    bool contains(const id_t& id) const { return index_.count(id) != 0; }
+
+    void erase(const id_t& id)
+    {
+        auto it = index_.find(id);
+        if (it != index_.end()) {
+            items_.erase(it->second);
+            index_.erase(it);
+        }
+    }
+
+    size_t size() const { return items_.size(); }
+
+    size_t DynamicMemoryUsage() const
+    {
+        // list node: value and two pointers
+        return memusage::MallocUsage(sizeof(typename list_t::value_type) + 2 * sizeof(void*)) * items_.size() +
+               memusage::DynamicUsage(index_);
+    }
+
+private:
+    using list_t = std::list<std::pair<id_t, PopP2PState>>;
+    list_t items_;
+    std::map<id_t, typename list_t::iterator> index_;
+    size_t capacity_;
+};
+
 // The state of the Node that stores already known Pop Data
 struct PopDataNodeState {
-    // we use map to store DDoS prevention counter as a value in the map
-    std::map<altintegration::ATV::id_t, PopP2PState> atv_state{};
-    std::map<altintegration::VTB::id_t, PopP2PState> vtb_state{};
-    std::map<altintegration::VbkBlock::id_t, PopP2PState> vbk_blocks_state{};
+    CRollingBloomFilter filterKnown{POP_KNOWN_FILTER_SIZE, 0.000001};
+    CRollingBloomFilter filterRequested{POP_REQUESTED_FILTER_SIZE, 0.001};
+
+    PopP2PStateCache<altintegration::ATV::id_t> atv_state{MAX_POP_RELAY_COUNTERS};
+    PopP2PStateCache<altintegration::VTB::id_t> vtb_state{MAX_POP_RELAY_COUNTERS};
+    PopP2PStateCache<altintegration::VbkBlock::id_t> vbk_blocks_state{MAX_POP_RELAY_COUNTERS};
+
+    // payloads to announce to the peer with the next trickle
+    std::set<altintegration::ATV::id_t> atv_to_send{};
+    std::set<altintegration::VTB::id_t> vtb_to_send{};
+    std::set<altintegration::VbkBlock::id_t> vbk_blocks_to_send{};
+    // whether payloads which were in PoP mempool on connect are queued
+    bool fMempoolQueued{false};
+    std::chrono::microseconds nNextInvSend{0};
 
     template <typename T>
-    std::map<typename T::id_t, PopP2PState>& getMap();
+    PopP2PStateCache<typename T::id_t>& getMap();
+
+    template <typename T>
+    std::set<typename T::id_t>& getInventoryToSend();
+
+    size_t DynamicMemoryUsage() const
+    {
+        return filterKnown.DynamicMemoryUsage() + filterRequested.DynamicMemoryUsage() +
+               memusage::DynamicUsage(atv_to_send) + memusage::DynamicUsage(vtb_to_send) + memusage::DynamicUsage(vbk_blocks_to_send) +
+               atv_state.DynamicMemoryUsage() + vtb_state.DynamicMemoryUsage() + vbk_blocks_state.DynamicMemoryUsage();
+    }
 };
 
-PopDataNodeState& getPopDataNodeState(const NodeId& id);
+PopDataNodeState& getPopDataNodeState(const NodeId& id) EXCLUSIVE_LOCKS_REQUIRED(cs_popmempool);
 
 void erasePopDataNodeState(const NodeId& id);
 
+//! Drop relay counters of payloads that left the PoP mempool from all peers
+void erasePopDataFromNodeStates(const altintegration::PopData& popData) EXCLUSIVE_LOCKS_REQUIRED(cs_popmempool);
+
+//! Drop relay counters of payloads of type pop_t from all peers
+template <typename pop_t>
+void erasePopDataFromNodeStates(const std::vector<typename pop_t::id_t>& ids) EXCLUSIVE_LOCKS_REQUIRED(cs_popmempool);
+
+//! Memory used by the PoP relay state of a peer, 0 if there is none
+size_t getPopDataNodeStateMemoryUsage(const NodeId& id);
+
 } // namespace p2p
 
 } // namespace VeriBlock
@@ -49,60 +153,18 @@ namespace VeriBlock {
 
 namespace p2p {
 
-const static std::string get_prefix = "g";
-const static std::string offer_prefix = "of";
-
-const static uint32_t MAX_POP_DATA_SENDING_AMOUNT = MAX_INV_SZ;
-const static uint32_t MAX_POP_MESSAGE_SENDING_COUNT = 30;
-
+/**
+ * Queue a payload accepted to the PoP mempool for announcement to all peers.
+ * Registered as PoP mempool onAccepted callback.
+ */
 template <typename pop_t>
-void offerPopDataToAllNodes(const pop_t& p)
-{
-    std::vector<std::vector<uint8_t>> p_id = {p.getId().asVector()};
-    CConnman* connman = g_rpc_node->connman.get();
-    const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
-
-    connman->ForEachNode([&connman, &msgMaker, &p_id](CNode* node) {
-        LOCK(cs_main);
-
-        auto& pop_state_map = getPopDataNodeState(node->GetId()).getMap<pop_t>();
-        PopP2PState& pop_state = pop_state_map[p_id[0]];
-        if (pop_state.offered_pop_data == 0) {
-            ++pop_state.offered_pop_data;
-            connman->PushMessage(node, msgMaker.Make(offer_prefix + pop_t::name(), p_id));
-        }
-    });
-}
-
-
-template <typename PopDataType>
-void offerPopData(CNode* node, CConnman* connman, const CNetMsgMaker& msgMaker) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
-{
-    AssertLockHeld(cs_main);
-    auto& pop_mempool = *VeriBlock::GetPop().mempool;
-    const auto& data = pop_mempool.getMap<PopDataType>();
-
-    auto& pop_state_map = getPopDataNodeState(node->GetId()).getMap<PopDataType>();
-
-    std::vector<std::vector<uint8_t>>
-        hashes;
-    for (const auto& el : data) {
-        PopP2PState& pop_state = pop_state_map[el.first];
-        if (pop_state.offered_pop_data == 0 && pop_state.known_pop_data == 0) {
-            ++pop_state.offered_pop_data;
-            hashes.push_back(el.first.asVector());
-        }
-
-        if (hashes.size() == MAX_POP_DATA_SENDING_AMOUNT) {
-            connman->PushMessage(node, msgMaker.Make(offer_prefix + PopDataType::name(), hashes));
-            hashes.clear();
-        }
-    }
+void offerPopDataToAllNodes(const pop_t& p);
 
-    if (!hashes.empty()) {
-        connman->PushMessage(node, msgMaker.Make(offer_prefix + PopDataType::name(), hashes));
-    }
-}
+/**
+ * Announce queued PoP payloads to a peer. Called from SendMessages; queues
+ * are drained with the same Poisson timing as transaction inventory.
+ */
+void sendPopInventory(CNode* node, CConnman* connman, const CNetMsgMaker& msgMaker, std::chrono::microseconds current_time);
 
 int processPopData(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman* connman);
 
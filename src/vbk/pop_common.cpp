@@ -10,8 +10,11 @@
 
 namespace VeriBlock {
 
+RecursiveMutex cs_popmempool;
+
 static std::shared_ptr<altintegration::Altintegration> app = nullptr;
 static std::shared_ptr<altintegration::Config> config = nullptr;
+static int keystoneInterval = 0;
 
 altintegration::Altintegration& GetPop()
 {
@@ -22,6 +25,13 @@ altintegration::Altintegration& GetPop()
 void SetPopConfig(const altintegration::Config& newConfig)
 {
     config = std::make_shared<altintegration::Config>(newConfig);
+    keystoneInterval = config->alt->getKeystoneInterval();
+}
+
+int GetKeystoneInterval()
+{
+    assert(keystoneInterval > 0 && "Config is not initialized. Invoke SetPopConfig.");
+    return keystoneInterval;
 }
 
 void SetPop(std::shared_ptr<altintegration::Repository>& db)
@@ -6,14 +6,24 @@
 #ifndef BITCOIN_SRC_VBK_POP_COMMON_HPP
 #define BITCOIN_SRC_VBK_POP_COMMON_HPP
 
+#include <sync.h>
 #include <veriblock/altintegration.hpp>
 
 namespace VeriBlock {
 
+/**
+ * Guards PoP mempool and per-peer PoP relay state. Code which needs both
+ * cs_main and this lock must take cs_main first.
+ */
+extern RecursiveMutex cs_popmempool;
+
 altintegration::Altintegration& GetPop();
 
 void SetPopConfig(const altintegration::Config& config);
 
+//! keystone interval of the ALT chain, cached by SetPopConfig
+int GetKeystoneInterval();
+
 void SetPop(std::shared_ptr<altintegration::Repository>& db);
 
 std::string toPrettyString(const altintegration::Altintegration& pop);
@@ -0,0 +1,132 @@
+// Copyright (c) 2019-2020 Xenios SEZC
+// https://www.veriblock.org
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <vbk/pop_db.hpp>
+
+#include <span.h>
+#include <txdb.h>
+#include <util/system.h>
+#include <util/time.h>
+#include <validation.h>
+#include <vbk/adaptors/batch_adapter.hpp>
+#include <vbk/pop_service.hpp>
+
+namespace VeriBlock {
+
+std::unique_ptr<PopDB> g_popdb;
+
+namespace {
+
+//! first bytes of keys of BTC/VBK/ALT block indices and tips
+const char POP_KEY_PREFIXES[] = {
+    DB_BTC_BLOCK, DB_BTC_BLOCK_LEGACY, DB_BTC_TIP,
+    DB_VBK_BLOCK, DB_VBK_BLOCK_LEGACY, DB_VBK_TIP,
+    DB_ALT_BLOCK, DB_ALT_BLOCK_LEGACY, DB_ALT_TIP};
+
+//! already serialized key or value, written as is
+struct RawBytes {
+    Span<const unsigned char> bytes;
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        s.write((const char*)bytes.data(), bytes.size());
+    }
+};
+
+fs::path PopDBPath()
+{
+    return GetDataDir() / "pop";
+}
+
+} // namespace
+
+PopDB::PopDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(PopDBPath(), nCacheSize, fMemory, fWipe)
+{
+}
+
+bool PopDB::Exists()
+{
+    return fs::exists(PopDBPath());
+}
+
+void PopDB::Destroy()
+{
+    LogPrintf("Removing %s\n", PopDBPath().string());
+    fs::remove_all(PopDBPath());
+}
+
+bool PopDB::MigrateFrom(CDBWrapper& blocktree)
+{
+    if (!hasPopData(blocktree)) {
+        return true;
+    }
+
+    const int64_t nTimeStart = GetTimeMillis();
+    LogPrintf("Moving BTC/VBK/ALT blocks from block tree database into %s\n", PopDBPath().string());
+
+    // everything is copied before anything is erased, so an interrupted
+    // migration is simply repeated on next start
+    std::vector<std::vector<unsigned char>> keys;
+    CDBBatch batch(*this);
+    std::unique_ptr<CDBIterator> iter(blocktree.NewIterator());
+    for (const char prefix : POP_KEY_PREFIXES) {
+        for (iter->Seek(prefix); iter->Valid(); iter->Next()) {
+            Span<const unsigned char> key = iter->GetKeyView();
+            if (key.size() == 0 || key[0] != (unsigned char)prefix) {
+                break;
+            }
+            Span<const unsigned char> value;
+            if (!iter->GetValueView(value)) {
+                return error("%s: block tree database is obfuscated", __func__);
+            }
+            batch.Write(RawBytes{key}, RawBytes{value});
+            keys.emplace_back(key.begin(), key.end());
+            if (batch.SizeEstimate() > nDefaultDbBatchSize) {
+                if (!WriteBatch(batch)) return false;
+                batch.Clear();
+            }
+        }
+    }
+    if (!WriteBatch(batch, true)) {
+        return error("%s: failed to write PoP database", __func__);
+    }
+
+    CDBBatch erase(blocktree);
+    for (const auto& key : keys) {
+        erase.Erase(RawBytes{MakeSpan(key)});
+        if (erase.SizeEstimate() > nDefaultDbBatchSize) {
+            if (!blocktree.WriteBatch(erase)) return false;
+            erase.Clear();
+        }
+    }
+    if (!blocktree.WriteBatch(erase, true)) {
+        return error("%s: failed to erase PoP data from block tree database", __func__);
+    }
+
+    LogPrintf("Moved %u entries into PoP database in %dms\n", keys.size(), GetTimeMillis() - nTimeStart);
+    return true;
+}
+
+bool PopDB::WriteTrees()
+{
+    CDBBatch batch(*this);
+    saveTrees(batch);
+    if (!WriteBatch(batch, true)) {
+        return false;
+    }
+    onTreesSaved();
+    return true;
+}
+
+CDBWrapper& GetPopDB()
+{
+    if (g_popdb) {
+        return *g_popdb;
+    }
+    return *pblocktree;
+}
+
+} // namespace VeriBlock
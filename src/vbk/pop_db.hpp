@@ -0,0 +1,60 @@
+// Copyright (c) 2019-2020 Xenios SEZC
+// https://www.veriblock.org
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SRC_VBK_POP_DB_HPP
+#define BITCOIN_SRC_VBK_POP_DB_HPP
+
+#include <dbwrapper.h>
+
+#include <memory>
+
+namespace VeriBlock {
+
+//! -popdb default
+static const bool DEFAULT_POPDB = false;
+//! -popdbcache default (MiB)
+static const int64_t DEFAULT_POPDB_CACHE = 16;
+//! min. -popdbcache (MiB)
+static const int64_t MIN_POPDB_CACHE = 2;
+//! max. -popdbcache (MiB)
+static const int64_t MAX_POPDB_CACHE = 1024;
+
+/**
+ * Dedicated database of BTC/VBK/ALT block indices and PoP library storage,
+ * in <datadir>/pop. With -popdb it is used instead of the block tree
+ * database, so PoP writes do not compete with the block index for its
+ * cache and compactions.
+ */
+class PopDB : public CDBWrapper
+{
+public:
+    explicit PopDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    //! true if the database has been created in the data directory
+    static bool Exists();
+
+    //! removes the database from the data directory. Must not be open.
+    static void Destroy();
+
+    /**
+     * Moves BTC/VBK/ALT block indices and tips, written by previous versions
+     * or without -popdb, from block tree db into this one. Does nothing if
+     * block tree db has no PoP tips.
+     */
+    bool MigrateFrom(CDBWrapper& blocktree);
+
+    //! writes BTC/VBK/ALT block indices changed since previous call, with sync
+    bool WriteTrees();
+};
+
+//! The dedicated PoP database, if -popdb is set. May be null.
+extern std::unique_ptr<PopDB> g_popdb;
+
+//! database which stores PoP data: g_popdb if it is set, block tree db otherwise
+CDBWrapper& GetPopDB();
+
+} // namespace VeriBlock
+
+#endif //BITCOIN_SRC_VBK_POP_DB_HPP
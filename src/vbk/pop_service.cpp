@@ -5,33 +5,69 @@
 
 #include <chain.h>
 #include <chainparams.h>
+#include <checkqueue.h>
 #include <consensus/validation.h>
 #include <dbwrapper.h>
+#include <hash.h>
 #include <shutdown.h>
+#include <util/threadnames.h>
+#include <util/time.h>
 #include <validation.h>
+#include <validationinterface.h>
 #include <vbk/adaptors/batch_adapter.hpp>
 #include <vbk/adaptors/repository.hpp>
 #include <veriblock/storage/util.hpp>
 
-#ifdef WIN32
-#include <boost/thread/interruption.hpp>
-#endif //WIN32
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <set>
+#include <thread>
 
 #include <vbk/p2p_sync.hpp>
 #include <vbk/pop_common.hpp>
 #include <vbk/pop_service.hpp>
+#include <vbk/pop_stats.hpp>
 
 namespace VeriBlock {
 
-void SetPop(CDBWrapper& db)
+//! BTC/VBK/ALT block indices and tips, as they are currently stored in block tree db
+static DirtyTracker dirtyTracker;
+
+//! storage of the PoP library, created by SetPop
+static std::shared_ptr<Repository> repository;
+
+bool g_pop_write_behind{DEFAULT_POP_WRITE_BEHIND};
+
+//! incremented whenever contents of PoP mempool change
+static std::atomic<uint32_t> popMempoolUpdated{0};
+
+template <typename pop_t>
+static void onPayloadAccepted(const pop_t& payload)
+{
+    ++popMempoolUpdated;
+    p2p::offerPopDataToAllNodes(payload);
+    GetMainSignals().PopPayloadAddedToMempool(payload);
+    // wake up getblocktemplate long polls
+    g_best_block_cv.notify_all();
+}
+
+void SetPop(CDBWrapper& db, CDBWrapper* legacydb)
 {
-    std::shared_ptr<altintegration::Repository> dbrepo = std::make_shared<Repository>(db);
+    repository = std::make_shared<Repository>(db, g_pop_write_behind, legacydb);
+    std::shared_ptr<altintegration::Repository> dbrepo = repository;
     SetPop(dbrepo);
+    dirtyTracker.clear();
+    ++popMempoolUpdated;
+    {
+        LOCK(cs_main);
+        onPopStateChanged();
+    }
 
     auto& app = GetPop();
-    app.mempool->onAccepted<altintegration::ATV>(VeriBlock::p2p::offerPopDataToAllNodes<altintegration::ATV>);
-    app.mempool->onAccepted<altintegration::VTB>(VeriBlock::p2p::offerPopDataToAllNodes<altintegration::VTB>);
-    app.mempool->onAccepted<altintegration::VbkBlock>(VeriBlock::p2p::offerPopDataToAllNodes<altintegration::VbkBlock>);
+    app.mempool->onAccepted<altintegration::ATV>(onPayloadAccepted<altintegration::ATV>);
+    app.mempool->onAccepted<altintegration::VTB>(onPayloadAccepted<altintegration::VTB>);
+    app.mempool->onAccepted<altintegration::VbkBlock>(onPayloadAccepted<altintegration::VbkBlock>);
 }
 
 bool acceptBlock(const CBlockIndex& indexNew, BlockValidationState& state)
@@ -39,7 +75,12 @@ bool acceptBlock(const CBlockIndex& indexNew, BlockValidationState& state)
     AssertLockHeld(cs_main);
     auto containing = VeriBlock::blockToAltBlock(indexNew);
     altintegration::ValidationState instate;
-    if (!GetPop().altTree->acceptBlockHeader(containing, instate)) {
+    bool accepted;
+    {
+        PopOperationTimer timer(PopOperation::ACCEPT_BLOCK_HEADER);
+        accepted = GetPop().altTree->acceptBlockHeader(containing, instate);
+    }
+    if (!accepted) {
         LogPrintf("ERROR: alt tree cannot accept block %s\n", instate.toString());
         return state.Invalid(BlockValidationResult::BLOCK_CACHED_INVALID, instate.GetPath());
     }
@@ -57,31 +98,148 @@ bool checkPopDataSize(const altintegration::PopData& popData, altintegration::Va
     return true;
 }
 
-bool popdataStatelessValidation(const altintegration::PopData& popData, altintegration::ValidationState& state)
+namespace {
+
+//! Outcome of a stateless check of a single payload
+struct PopCheckResult {
+    bool done{false};
+    bool valid{true};
+    altintegration::ValidationState state;
+};
+
+//! Payloads of PopData are enumerated in validation order: context blocks, then VTBs, then ATVs
+size_t payloadsCount(const altintegration::PopData& popData)
 {
-    auto& config = *GetPop().config;
+    return popData.context.size() + popData.vtbs.size() + popData.atvs.size();
+}
 
-    for (const auto& b : popData.context) {
-        if (!altintegration::checkBlock(b, state, *config.vbk.params)) {
-            return state.Invalid("pop-vbkblock-statelessly-invalid");
+std::string rejectReason(const altintegration::PopData& popData, size_t i)
+{
+    if (i < popData.context.size()) {
+        return "pop-vbkblock-statelessly-invalid";
+    }
+    if (i < popData.context.size() + popData.vtbs.size()) {
+        return "pop-vtb-statelessly-invalid";
+    }
+    return "pop-atv-statelessly-invalid";
+}
+
+/**
+ * Closure representing a stateless check of i-th payload of PopData.
+ * Result is stored into a slot owned by the caller, so that failures can be
+ * reported in validation order regardless of the order checks were run in.
+ */
+class CPopCheck
+{
+private:
+    const altintegration::PopData* popData{nullptr};
+    size_t index{0};
+    PopCheckResult* result{nullptr};
+
+public:
+    CPopCheck() = default;
+    CPopCheck(const altintegration::PopData& popDataIn, size_t indexIn, PopCheckResult& resultIn) : popData(&popDataIn), index(indexIn), result(&resultIn) {}
+
+    bool operator()()
+    {
+        auto& config = *GetPop().config;
+        auto& state = result->state;
+        size_t i = index;
+        if (i < popData->context.size()) {
+            result->valid = altintegration::checkBlock(popData->context[i], state, *config.vbk.params);
+        } else if ((i -= popData->context.size()) < popData->vtbs.size()) {
+            result->valid = altintegration::checkVTB(popData->vtbs[i], state, *config.btc.params);
+        } else {
+            i -= popData->vtbs.size();
+            result->valid = altintegration::checkATV(popData->atvs[i], state, *config.alt);
         }
+        result->done = true;
+        return result->valid;
     }
 
-    for (const auto& vtb : popData.vtbs) {
-        if (!altintegration::checkVTB(vtb, state, *config.btc.params)) {
-            return state.Invalid("pop-vtb-statelessly-invalid");
+    void swap(CPopCheck& check)
+    {
+        std::swap(popData, check.popData);
+        std::swap(index, check.index);
+        std::swap(result, check.result);
+    }
+};
+
+CCheckQueue<CPopCheck> popcheckqueue(16);
+
+} // namespace
+
+bool g_parallel_pop_checks{false};
+
+void ThreadPopCheck(int worker_num)
+{
+    util::ThreadRename(strprintf("popch.%i", worker_num));
+    popcheckqueue.Thread();
+}
+
+//! Run stateless checks of popData on popcheckqueue threads, if there are any
+static std::vector<PopCheckResult> runPopChecks(const altintegration::PopData& popData)
+{
+    const size_t count = payloadsCount(popData);
+    std::vector<PopCheckResult> results(count);
+
+    if (g_parallel_pop_checks && count > 1) {
+        std::vector<CPopCheck> vChecks;
+        vChecks.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            vChecks.emplace_back(popData, i, results[i]);
         }
+
+        CCheckQueueControl<CPopCheck> control(&popcheckqueue);
+        control.Add(vChecks);
+        control.Wait();
     }
 
-    for (const auto& atv : popData.atvs) {
-        if (!altintegration::checkATV(atv, state, *config.alt)) {
-            return state.Invalid("pop-atv-statelessly-invalid");
+    return results;
+}
+
+bool popdataStatelessValidation(const altintegration::PopData& popData, altintegration::ValidationState& state)
+{
+    const size_t count = payloadsCount(popData);
+    std::vector<PopCheckResult> results = runPopChecks(popData);
+
+    // The queue stops executing checks once any of them fails, which is not
+    // necessarily the first invalid payload. Finish the remaining checks in
+    // order, so that the reported failure does not depend on thread timing.
+    for (size_t i = 0; i < count; ++i) {
+        auto& result = results[i];
+        if (!result.done) {
+            CPopCheck(popData, i, result)();
+        }
+        if (!result.valid) {
+            state = result.state;
+            return state.Invalid(rejectReason(popData, i));
         }
     }
 
     return true;
 }
 
+std::vector<altintegration::ValidationState> payloadsStatelessValidation(const altintegration::PopData& popData)
+{
+    const size_t count = payloadsCount(popData);
+    std::vector<PopCheckResult> results = runPopChecks(popData);
+
+    std::vector<altintegration::ValidationState> states(count);
+    for (size_t i = 0; i < count; ++i) {
+        auto& result = results[i];
+        if (!result.done) {
+            CPopCheck(popData, i, result)();
+        }
+        states[i] = result.state;
+        if (!result.valid) {
+            states[i].Invalid(rejectReason(popData, i));
+        }
+    }
+
+    return states;
+}
+
 bool addAllBlockPayloads(const CBlock& block, BlockValidationState& state) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     AssertLockHeld(cs_main);
@@ -98,7 +256,14 @@ bool addAllBlockPayloads(const CBlock& block, BlockValidationState& state) EXCLU
             instate.toString());
     }
 
-    if (!GetPop().altTree->addPayloads(block.GetHash().asVector(), block.popData, instate)) {
+    // new payloads change PoP score of every fork containing this block
+    onPopStateChanged();
+    bool added;
+    {
+        PopOperationTimer timer(PopOperation::ADD_PAYLOADS);
+        added = GetPop().altTree->addPayloads(block.GetHash().asVector(), block.popData, instate);
+    }
+    if (!added) {
         state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, instate.toString(), "");
         return error("[%s] block %s failed stateful pop validation: %s", __func__, block.GetHash().ToString(),
             instate.toString());
@@ -107,24 +272,168 @@ bool addAllBlockPayloads(const CBlock& block, BlockValidationState& state) EXCLU
     return true;
 }
 
+namespace {
+
+//! upper bound on the number of memoized template checks
+const size_t MAX_TEMPLATE_POP_CHECKS = 1000;
+
+//! (parent, hash of PopData) of block templates found valid, until PoP state changes
+std::set<std::pair<uint256, uint256>> validTemplatePopData GUARDED_BY(cs_main);
+
+} // namespace
+
+bool testBlockPopValidity(const CBlock& block, const CBlockIndex& pindexPrev, BlockValidationState& state) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    AssertLockHeld(cs_main);
+    auto key = std::make_pair(pindexPrev.GetBlockHash(), SerializeHash(block.popData));
+    if (validTemplatePopData.count(key)) {
+        return true;
+    }
+
+    altintegration::ValidationState instate;
+    if (!setState(pindexPrev.GetBlockHash(), instate)) {
+        return state.Invalid(BlockValidationResult::BLOCK_INVALID_PREV, "bad-prevblk-pop", instate.toString());
+    }
+    if ((block.nVersion & POP_BLOCK_VERSION_BIT) &&
+        (!checkPopDataSize(block.popData, instate) || !popdataStatelessValidation(block.popData, instate))) {
+        return state.Invalid(BlockValidationResult::BLOCK_CONSENSUS, "bad-block-pop", instate.toString());
+    }
+
+    if (validTemplatePopData.size() >= MAX_TEMPLATE_POP_CHECKS) {
+        validTemplatePopData.clear();
+    }
+    validTemplatePopData.insert(key);
+    return true;
+}
+
 bool setState(const uint256& block, altintegration::ValidationState& state) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     AssertLockHeld(cs_main);
-    return GetPop().altTree->setState(block.asVector(), state);
+    PopOperationTimer timer(PopOperation::SET_STATE);
+    if (!GetPop().altTree->setState(block.asVector(), state)) {
+        // failed state change marks blocks invalid, which changes PoP score of forks containing them
+        onPopStateChanged();
+        return false;
+    }
+    return true;
 }
 
 altintegration::PopData getPopData() EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     AssertLockHeld(cs_main);
+    LOCK(cs_popmempool);
     return GetPop().mempool->getPop();
 }
 
-PoPRewards getPopRewards(const CBlockIndex& pindexPrev, const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+namespace {
+
+//! upper bound on serialized size of PopData, apart from its payloads
+const size_t POP_DATA_SERIALIZED_OVERHEAD = 64;
+
+//! PoP mempool contents on top of a tip, with serialized sizes of payloads
+struct PopCandidates {
+    uint256 tip{};
+    uint32_t updated{0};
+    bool valid{false};
+    altintegration::PopData popData{};
+    std::vector<size_t> contextSizes{};
+    std::vector<size_t> vtbSizes{};
+    std::vector<size_t> atvSizes{};
+};
+
+PopCandidates popCandidates GUARDED_BY(cs_main);
+
+template <typename pop_t>
+std::vector<size_t> serializedSizes(const std::vector<pop_t>& payloads)
+{
+    std::vector<size_t> sizes;
+    sizes.reserve(payloads.size());
+    for (const auto& payload : payloads) {
+        sizes.push_back(::GetSerializeSize(payload, CLIENT_VERSION));
+    }
+    return sizes;
+}
+
+//! Greedily add payloads which still fit into nMaxSize. Returns false if some of them did not fit.
+template <typename pop_t>
+bool addFittingPayloads(std::vector<pop_t>& out, const std::vector<pop_t>& candidates, const std::vector<size_t>& sizes, size_t& nSize, size_t nMaxSize, bool prefix)
+{
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (nSize + sizes[i] > nMaxSize) {
+            if (prefix) {
+                return false;
+            }
+            continue;
+        }
+        nSize += sizes[i];
+        out.push_back(candidates[i]);
+    }
+    return out.size() == candidates.size();
+}
+
+} // namespace
+
+uint32_t getPopMempoolUpdated()
+{
+    return popMempoolUpdated;
+}
+
+altintegration::PopData selectPopData(const CBlockIndex& tip, size_t nMaxSize) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
-    const auto& pop = GetPop();
     AssertLockHeld(cs_main);
+    const uint32_t updated = popMempoolUpdated;
+    if (!popCandidates.valid || popCandidates.tip != tip.GetBlockHash() || popCandidates.updated != updated) {
+        popCandidates.popData = getPopData();
+        popCandidates.contextSizes = serializedSizes(popCandidates.popData.context);
+        popCandidates.vtbSizes = serializedSizes(popCandidates.popData.vtbs);
+        popCandidates.atvSizes = serializedSizes(popCandidates.popData.atvs);
+        popCandidates.tip = tip.GetBlockHash();
+        popCandidates.updated = updated;
+        popCandidates.valid = true;
+    }
+
+    // checkPopDataSize requires size to be strictly less than the limit
+    nMaxSize = std::min<size_t>(nMaxSize, GetPop().config->alt->getMaxPopDataSize() - 1);
+
+    const auto& candidates = popCandidates.popData;
+    altintegration::PopData selected;
+    size_t nSize = POP_DATA_SERIALIZED_OVERHEAD;
+    // payloads may depend on any of the context blocks, so context is taken
+    // in order and nothing else is added if it does not fit
+    if (!addFittingPayloads(selected.context, candidates.context, popCandidates.contextSizes, nSize, nMaxSize, true)) {
+        selected.context.clear();
+    } else {
+        addFittingPayloads(selected.atvs, candidates.atvs, popCandidates.atvSizes, nSize, nMaxSize, false);
+        addFittingPayloads(selected.vtbs, candidates.vtbs, popCandidates.vtbSizes, nSize, nMaxSize, false);
+    }
+
+    // sizes above are estimates of PopData encoding
+    while (::GetSerializeSize(selected, CLIENT_VERSION) > nMaxSize) {
+        if (!selected.vtbs.empty()) {
+            selected.vtbs.pop_back();
+        } else if (!selected.atvs.empty()) {
+            selected.atvs.pop_back();
+        } else {
+            selected.context.pop_back();
+        }
+    }
+
+    return selected;
+}
+
+namespace {
+
+//! upper bound on the number of cached block rewards
+const size_t MAX_POP_REWARDS_CACHE = 100;
+
+//! PoP rewards paid by a child of the key block, valid until PoP state changes
+std::map<uint256, PoPRewards> popRewardsCache GUARDED_BY(cs_main);
+
+PoPRewards calculatePopRewards(const CBlockIndex& pindexPrev, const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    const auto& pop = GetPop();
     altintegration::ValidationState state;
-    bool ret = pop.altTree->setState(pindexPrev.GetBlockHash().asVector(), state);
+    bool ret = setState(pindexPrev.GetBlockHash(), state);
     (void)ret;
     assert(ret);
 
@@ -133,7 +442,9 @@ PoPRewards getPopRewards(const CBlockIndex& pindexPrev, const Consensus::Params&
         return {};
     }
     auto blockHash = pindexPrev.GetBlockHash();
+    int64_t nTimeStart = GetTimeMicros();
     auto rewards = pop.altTree->getPopPayout(blockHash.asVector());
+    recordPopOperation(PopOperation::GET_POP_PAYOUT, GetTimeMicros() - nTimeStart);
     int halvings = (pindexPrev.nHeight + 1) / consensusParams.nSubsidyHalvingInterval;
     PoPRewards btcRewards{};
     auto& param = Params();
@@ -150,6 +461,25 @@ PoPRewards getPopRewards(const CBlockIndex& pindexPrev, const Consensus::Params&
     return btcRewards;
 }
 
+} // namespace
+
+PoPRewards getPopRewards(const CBlockIndex& pindexPrev, const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    AssertLockHeld(cs_main);
+    const auto hash = pindexPrev.GetBlockHash();
+    auto it = popRewardsCache.find(hash);
+    if (it != popRewardsCache.end()) {
+        return it->second;
+    }
+
+    PoPRewards rewards = calculatePopRewards(pindexPrev, consensusParams);
+    if (popRewardsCache.size() >= MAX_POP_REWARDS_CACHE) {
+        popRewardsCache.clear();
+    }
+    popRewardsCache.emplace(hash, rewards);
+    return rewards;
+}
+
 void addPopPayoutsIntoCoinbaseTx(CMutableTransaction& coinbaseTx, const CBlockIndex& pindexPrev, const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     AssertLockHeld(cs_main);
@@ -235,137 +565,392 @@ std::vector<BlockBytes> getLastKnownBTCBlocks(size_t blocks)
     return altintegration::getLastKnownBlocks(GetPop().altTree->btc(), blocks);
 }
 
-bool hasPopData(CBlockTreeDB& db)
+bool hasPopData(CDBWrapper& db)
 {
     return db.Exists(BatchAdapter::btctip()) && db.Exists(BatchAdapter::vbktip()) && db.Exists(BatchAdapter::alttip());
 }
 
-void saveTrees(altintegration::BatchAdaptor& batch)
+void saveTrees(CDBBatch& batch)
 {
     AssertLockHeld(cs_main);
-    altintegration::SaveAllTrees(*GetPop().altTree, batch);
+    int64_t nTimeStart = GetTimeMicros();
+    BatchAdapter adaptor(batch, &dirtyTracker);
+    // every block index is still encoded and compared, see DirtyTracker
+    altintegration::SaveAllTrees(*GetPop().altTree, adaptor);
+    repository->flush(batch);
+    LogPrint(BCLog::BENCH, "    - Write PoP trees: %.2fms [%u written, %u unchanged, all indices scanned]\n",
+        (GetTimeMicros() - nTimeStart) * 0.001, adaptor.written(), adaptor.skipped());
 }
 
+void onTreesSaved()
+{
+    repository->flushed();
+}
+
+namespace {
+
+//! Block indices of a single tree, as read from disk
+template <typename BlockTree>
+struct DiskTree {
+    using index_t = typename BlockTree::index_t;
+    using hash_t = typename BlockTree::hash_t;
+
+    const char blocktype;
+    const char legacytype;
+    const std::pair<char, std::string> tiptype;
+
+    hash_t tiphash{};
+    std::vector<index_t> blocks{};
+    //! true if blocks are stored under legacy keys and have to be migrated
+    bool legacy{false};
+    //! blocks and tip, as they are stored on disk
+    DirtyTracker written{};
+    bool ok{false};
+    int64_t nTimeRead{0};
+
+    DiskTree(char blocktypeIn, char legacytypeIn, std::pair<char, std::string> tiptypeIn)
+        : blocktype(blocktypeIn), legacytype(legacytypeIn), tiptype(std::move(tiptypeIn)) {}
+};
+
 template <typename BlockTree>
-bool LoadTree(CDBIterator& iter, char blocktype, std::pair<char, std::string> tiptype, BlockTree& out, altintegration::ValidationState& state)
+bool ReadBlocks(CDBWrapper& db, DiskTree<BlockTree>& tree)
 {
     using index_t = typename BlockTree::index_t;
     using block_t = typename index_t::block_t;
     using hash_t = typename BlockTree::hash_t;
 
-    // Load tip
-    hash_t tiphash;
-    std::pair<char, std::string> ckey;
-
-    iter.Seek(tiptype);
-    if (!iter.Valid()) {
-        // no valid tip is stored = no need to load anything
-        return error("%s: failed to load %s tip", block_t::name());
-    }
-    if (!iter.GetKey(ckey)) {
-        return error("%s: failed to find key %c:%s in %s", __func__, tiptype.first, tiptype.second, block_t::name());
-    }
-    if (ckey != tiptype) {
-        return error("%s: bad key for tip %c:%s in %s", __func__, tiptype.first, tiptype.second, block_t::name());
+    if (!db.Read(tree.tiptype, tree.tiphash)) {
+        return error("%s: failed to read %s tip", __func__, block_t::name());
     }
-    if (!iter.GetValue(tiphash)) {
-        return error("%s: failed to read tip value in %s", __func__, block_t::name());
+    tree.written.setWritten(tree.tiptype.first, {}, std::vector<uint8_t>(tree.tiphash.begin(), tree.tiphash.end()));
+
+    // blocks are keyed by height, so they are read already sorted
+    std::unique_ptr<CDBIterator> iter(db.NewIterator());
+    iter->Seek(std::make_pair(tree.blocktype, uint32_t(0)));
+    while (iter->Valid()) {
+        if (ShutdownRequested()) return false;
+        BlockIndexKey<hash_t> key;
+        if (!iter->GetKey(key) || key.prefix != tree.blocktype) {
+            break;
+        }
+        index_t diskindex;
+        if (!iter->GetValue(diskindex)) {
+            return error("%s: failed to read %s block", __func__, block_t::name());
+        }
+        tree.written.setWritten(tree.blocktype, std::vector<uint8_t>(key.hash.begin(), key.hash.end()), diskindex.toRaw());
+        tree.blocks.push_back(std::move(diskindex));
+        iter->Next();
     }
 
-    std::vector<index_t> blocks;
+    if (!tree.blocks.empty()) {
+        return true;
+    }
 
-    // Load blocks
-    iter.Seek(std::make_pair(blocktype, hash_t()));
-    while (iter.Valid()) {
-#if defined BOOST_THREAD_PROVIDES_INTERRUPTIONS
-        boost::this_thread::interruption_point();
-#endif
+    // blocks written by previous versions are keyed by hash
+    iter->Seek(std::make_pair(tree.legacytype, hash_t()));
+    while (iter->Valid()) {
         if (ShutdownRequested()) return false;
         std::pair<char, hash_t> key;
-        if (iter.GetKey(key) && key.first == blocktype) {
-            index_t diskindex;
-            if (iter.GetValue(diskindex)) {
-                blocks.push_back(diskindex);
-                iter.Next();
-            } else {
-                return error("%s: failed to read %s block", __func__, block_t::name());
-            }
-        } else {
+        if (!iter->GetKey(key) || key.first != tree.legacytype) {
             break;
         }
+        index_t diskindex;
+        if (!iter->GetValue(diskindex)) {
+            return error("%s: failed to read %s block", __func__, block_t::name());
+        }
+        tree.blocks.push_back(std::move(diskindex));
+        iter->Next();
     }
 
-    // sort blocks by height
-    std::sort(blocks.begin(), blocks.end(), [](const index_t& a, const index_t& b) {
+    tree.legacy = !tree.blocks.empty();
+    std::sort(tree.blocks.begin(), tree.blocks.end(), [](const index_t& a, const index_t& b) {
         return a.getHeight() < b.getHeight();
     });
-    if (!altintegration::LoadTree(out, blocks, tiphash, state)) {
+    return true;
+}
+
+//! rewrites blocks stored under legacy keys into height ordered keys
+template <typename BlockTree>
+bool MigrateBlocks(CDBWrapper& db, DiskTree<BlockTree>& tree)
+{
+    using block_t = typename BlockTree::index_t::block_t;
+
+    CDBBatch batch(db);
+    BatchAdapter adaptor(batch, &tree.written);
+    for (const auto& index : tree.blocks) {
+        adaptor.writeBlock(index);
+        batch.Erase(std::make_pair(tree.legacytype, index.getHash()));
+    }
+    if (!db.WriteBatch(batch, true)) {
+        return error("%s: failed to migrate %s blocks", __func__, block_t::name());
+    }
+    LogPrintf("Migrated %d blocks of %s tree to height ordered keys\n", tree.blocks.size(), block_t::name());
+    return true;
+}
+
+template <typename BlockTree>
+std::thread StartReadBlocks(CDBWrapper& db, DiskTree<BlockTree>& tree)
+{
+    return std::thread([&db, &tree]() {
+        int64_t nTimeStart = GetTimeMicros();
+        tree.ok = ReadBlocks(db, tree);
+        tree.nTimeRead = GetTimeMicros() - nTimeStart;
+    });
+}
+
+template <typename BlockTree>
+bool LoadTree(CDBWrapper& db, DiskTree<BlockTree>& disk, BlockTree& out, altintegration::ValidationState& state)
+{
+    using block_t = typename BlockTree::index_t::block_t;
+
+    if (!disk.ok) {
+        return error("%s: failed to read tree %s", __func__, block_t::name());
+    }
+    if (disk.legacy && !MigrateBlocks(db, disk)) {
+        return false;
+    }
+
+    int64_t nTimeStart = GetTimeMicros();
+    if (!altintegration::LoadTree(out, disk.blocks, disk.tiphash, state)) {
         return error("%s: failed to load tree %s", __func__, block_t::name());
     }
+    dirtyTracker.merge(disk.written);
 
     auto* tip = out.getBestChain().tip();
     assert(tip);
-    LogPrintf("Loaded %d blocks in %s tree with tip %s\n", out.getBlocks().size(), block_t::name(), tip->toShortPrettyString());
+    LogPrintf("Loaded %d blocks in %s tree with tip %s (read %.2fms, load %.2fms)\n", out.getBlocks().size(), block_t::name(),
+        tip->toShortPrettyString(), disk.nTimeRead * 0.001, (GetTimeMicros() - nTimeStart) * 0.001);
 
     return true;
 }
 
-bool loadTrees(CDBIterator& iter)
+} // namespace
+
+bool loadTrees(CDBWrapper& db)
 {
     auto& pop = GetPop();
+    DiskTree<altintegration::VbkBlockTree::BtcTree> btc(DB_BTC_BLOCK, DB_BTC_BLOCK_LEGACY, BatchAdapter::btctip());
+    DiskTree<altintegration::VbkBlockTree> vbk(DB_VBK_BLOCK, DB_VBK_BLOCK_LEGACY, BatchAdapter::vbktip());
+    DiskTree<altintegration::AltTree> alt(DB_ALT_BLOCK, DB_ALT_BLOCK_LEGACY, BatchAdapter::alttip());
+
+    // Trees depend on each other, so they are loaded one by one. Reading and
+    // deserializing their blocks is independent, and is done concurrently.
+    std::thread btcReader = StartReadBlocks(db, btc);
+    std::thread vbkReader = StartReadBlocks(db, vbk);
+    std::thread altReader = StartReadBlocks(db, alt);
+    btcReader.join();
+    vbkReader.join();
+    altReader.join();
+
     altintegration::ValidationState state;
-    if (!LoadTree(iter, DB_BTC_BLOCK, BatchAdapter::btctip(), pop.altTree->btc(), state)) {
+    if (!LoadTree(db, btc, pop.altTree->btc(), state)) {
         return error("%s: failed to load BTC tree %s", __func__, state.toString());
     }
-    if (!LoadTree(iter, DB_VBK_BLOCK, BatchAdapter::vbktip(), pop.altTree->vbk(), state)) {
+    if (!LoadTree(db, vbk, pop.altTree->vbk(), state)) {
         return error("%s: failed to load VBK tree %s", __func__, state.toString());
     }
-    if (!LoadTree(iter, DB_ALT_BLOCK, BatchAdapter::alttip(), *pop.altTree, state)) {
+    if (!LoadTree(db, alt, *pop.altTree, state)) {
         return error("%s: failed to load ALT tree %s", __func__, state.toString());
     }
     return true;
 }
 
+namespace {
+
+/**
+ * Payloads of disconnected blocks, waiting to be resubmitted into PoP mempool
+ * at the end of a reorg. Payloads are kept once, even if several disconnected
+ * blocks contain them, and are dropped when a newly connected block contains
+ * them too, so they are not validated by the mempool just to be removed again.
+ */
+template <typename pop_t>
+class DisconnectedPayloads
+{
+public:
+    void add(const std::vector<pop_t>& payloads)
+    {
+        for (const auto& p : payloads) {
+            m_payloads.emplace(p.getId(), p);
+        }
+    }
+
+    void remove(const std::vector<pop_t>& payloads)
+    {
+        for (const auto& p : payloads) {
+            m_payloads.erase(p.getId());
+        }
+    }
+
+    bool empty() const { return m_payloads.empty(); }
+
+    //! moves payloads into `out`, ordered by height of the VBK block they depend on
+    template <typename Height>
+    void take(std::vector<pop_t>& out, Height height)
+    {
+        out.reserve(out.size() + m_payloads.size());
+        for (auto& p : m_payloads) {
+            out.push_back(std::move(p.second));
+        }
+        m_payloads.clear();
+        // ties keep id order, so the result does not depend on the order of disconnection
+        std::stable_sort(out.begin(), out.end(), [&height](const pop_t& a, const pop_t& b) {
+            return height(a) < height(b);
+        });
+    }
+
+private:
+    std::map<typename pop_t::id_t, pop_t> m_payloads;
+};
+
+DisconnectedPayloads<altintegration::VbkBlock> disconnectedVbkBlocks GUARDED_BY(cs_main);
+DisconnectedPayloads<altintegration::VTB> disconnectedVtbs GUARDED_BY(cs_main);
+DisconnectedPayloads<altintegration::ATV> disconnectedAtvs GUARDED_BY(cs_main);
+
+} // namespace
+
 void updatePopMempoolForReorg() EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
-    auto& pop = GetPop();
-    for (const auto& popData : pop.disconnected_popdata) {
-        pop.mempool->submitAll(popData);
+    AssertLockHeld(cs_main);
+    if (disconnectedVbkBlocks.empty() && disconnectedVtbs.empty() && disconnectedAtvs.empty()) {
+        return;
     }
-    pop.disconnected_popdata.clear();
+
+    // payloads may depend on ones from lower blocks, so they are submitted in
+    // topological order: VBK context first, then VTBs, then ATVs
+    altintegration::PopData popData;
+    disconnectedVbkBlocks.take(popData.context, [](const altintegration::VbkBlock& b) { return b.getHeight(); });
+    disconnectedVtbs.take(popData.vtbs, [](const altintegration::VTB& vtb) { return vtb.containingBlock.getHeight(); });
+    disconnectedAtvs.take(popData.atvs, [](const altintegration::ATV& atv) { return atv.blockOfProof.getHeight(); });
+
+    LogPrint(BCLog::BENCH, "  - Resubmit disconnected PoP payloads: %u VBK blocks, %u VTBs, %u ATVs\n",
+        popData.context.size(), popData.vtbs.size(), popData.atvs.size());
+
+    LOCK(cs_popmempool);
+    {
+        PopOperationTimer timer(PopOperation::MEMPOOL_SUBMIT);
+        GetPop().mempool->submitAll(popData);
+    }
+    ++popMempoolUpdated;
 }
 
 void addDisconnectedPopdata(const altintegration::PopData& popData) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
-    GetPop().disconnected_popdata.push_back(popData);
+    AssertLockHeld(cs_main);
+    disconnectedVbkBlocks.add(popData.context);
+    disconnectedVtbs.add(popData.vtbs);
+    disconnectedAtvs.add(popData.atvs);
+}
+
+namespace {
+
+template <typename pop_t>
+std::vector<typename pop_t::id_t> getMempoolIds(const altintegration::MemPool& mempool) EXCLUSIVE_LOCKS_REQUIRED(cs_popmempool)
+{
+    std::vector<typename pop_t::id_t> ids;
+    for (const auto& el : mempool.getMap<pop_t>()) {
+        ids.push_back(el.first);
+    }
+    return ids;
 }
 
+//! drop relay counters of payloads from ids which are not in PoP mempool anymore
+template <typename pop_t>
+void eraseRemovedFromNodeStates(const altintegration::MemPool& mempool, const std::vector<typename pop_t::id_t>& ids) EXCLUSIVE_LOCKS_REQUIRED(cs_popmempool)
+{
+    std::vector<typename pop_t::id_t> removed;
+    for (const auto& id : ids) {
+        if (mempool.get<pop_t>(id) == nullptr) {
+            removed.push_back(id);
+        }
+    }
+    p2p::erasePopDataFromNodeStates<pop_t>(removed);
+}
+
+} // namespace
+
 void removePayloadsFromMempool(const altintegration::PopData& popData) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     AssertLockHeld(cs_main);
-    GetPop().mempool->removePayloads(popData);
+    // payloads are in the active chain again
+    disconnectedVbkBlocks.remove(popData.context);
+    disconnectedVtbs.remove(popData.vtbs);
+    disconnectedAtvs.remove(popData.atvs);
+
+    LOCK(cs_popmempool);
+    auto& mempool = *GetPop().mempool;
+    // besides mined payloads, PoP mempool drops the ones which became stale
+    auto vbkBlocks = getMempoolIds<altintegration::VbkBlock>(mempool);
+    auto vtbs = getMempoolIds<altintegration::VTB>(mempool);
+    auto atvs = getMempoolIds<altintegration::ATV>(mempool);
+    mempool.removePayloads(popData);
+    p2p::erasePopDataFromNodeStates(popData);
+    eraseRemovedFromNodeStates<altintegration::VbkBlock>(mempool, vbkBlocks);
+    eraseRemovedFromNodeStates<altintegration::VTB>(mempool, vtbs);
+    eraseRemovedFromNodeStates<altintegration::ATV>(mempool, atvs);
+    ++popMempoolUpdated;
 }
 
-int compareForks(const CBlockIndex& leftForkTip, const CBlockIndex& rightForkTip) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+namespace {
+
+//! upper bound on the number of memoized fork comparisons
+const size_t MAX_FORK_COMPARISONS = 10000;
+
+//! results of compareForks for (left, right) fork tips, valid until PoP state changes
+std::map<std::pair<uint256, uint256>, int> forkComparisons GUARDED_BY(cs_main);
+
+int comparePopScore(const CBlockIndex& leftForkTip, const CBlockIndex& rightForkTip) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
+    PopOperationTimer timer(PopOperation::COMPARE_POP_SCORE);
     auto& pop = GetPop();
-    AssertLockHeld(cs_main);
-    if (&leftForkTip == &rightForkTip) {
-        return 0;
-    }
-
-    auto left = blockToAltBlock(leftForkTip);
-    auto right = blockToAltBlock(rightForkTip);
     auto state = altintegration::ValidationState();
 
-    if (!pop.altTree->setState(left.hash, state)) {
-        if (!pop.altTree->setState(right.hash, state)) {
+    if (!setState(leftForkTip.GetBlockHash(), state)) {
+        // left fork has been marked as invalid
+        if (!setState(rightForkTip.GetBlockHash(), state)) {
             throw std::logic_error("both chains are invalid");
         }
         return -1;
     }
 
-    return pop.altTree->comparePopScore(left.hash, right.hash);
+    auto right = rightForkTip.GetBlockHash().asVector();
+    int result = pop.altTree->comparePopScore(leftForkTip.GetBlockHash().asVector(), right);
+    // right fork loses if its payloads fail to apply, and its blocks are marked invalid then
+    auto* rightIndex = pop.altTree->getBlockIndex(right);
+    if (result > 0 && rightIndex && !rightIndex->isValid()) {
+        onPopStateChanged();
+    }
+    return result;
+}
+
+} // namespace
+
+void onPopStateChanged() EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    AssertLockHeld(cs_main);
+    forkComparisons.clear();
+    popRewardsCache.clear();
+    validTemplatePopData.clear();
+}
+
+int compareForks(const CBlockIndex& leftForkTip, const CBlockIndex& rightForkTip) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    AssertLockHeld(cs_main);
+    if (&leftForkTip == &rightForkTip) {
+        return 0;
+    }
+
+    auto key = std::make_pair(leftForkTip.GetBlockHash(), rightForkTip.GetBlockHash());
+    auto it = forkComparisons.find(key);
+    if (it != forkComparisons.end()) {
+        return it->second;
+    }
+
+    int result = comparePopScore(leftForkTip, rightForkTip);
+    if (forkComparisons.size() >= MAX_FORK_COMPARISONS) {
+        forkComparisons.clear();
+    }
+    forkComparisons.emplace(key, result);
+    return result;
 }
 
 CAmount getCoinbaseSubsidy(const CAmount& subsidy)
@@ -11,9 +11,9 @@
 
 class BlockValidationState;
 class CBlock;
+class CDBBatch;
 class CBlockTreeDB;
 class CBlockIndex;
-class CDBIterator;
 class CDBWrapper;
 
 namespace Consensus {
@@ -25,14 +25,49 @@ namespace VeriBlock {
 using BlockBytes = std::vector<uint8_t>;
 using PoPRewards = std::map<CScript, CAmount>;
 
-void SetPop(CDBWrapper& db);
+/** Maximum number of dedicated PoP payload verification threads. */
+static const int MAX_POPCHECK_THREADS = 15;
+/** -parpop default (number of PoP payload verification threads, 0 = auto) */
+static const int DEFAULT_POPCHECK_THREADS = 0;
+
+extern bool g_parallel_pop_checks;
+
+/** -popwritebehind default */
+static const bool DEFAULT_POP_WRITE_BEHIND = false;
+
+/** Whether writes of the PoP library are queued until FlushStateToDisk, see Repository */
+extern bool g_pop_write_behind;
+
+/** Run an instance of the PoP payload checking thread */
+void ThreadPopCheck(int worker_num);
+
+/**
+ * Set up PoP library storage in db. Entries not found in db are read from
+ * legacydb, if given, which stored PoP data before it was moved to db.
+ */
+void SetPop(CDBWrapper& db, CDBWrapper* legacydb = nullptr);
 
 bool acceptBlock(const CBlockIndex& indexNew, BlockValidationState& state);
 bool checkPopDataSize(const altintegration::PopData& popData, altintegration::ValidationState& state);
 bool popdataStatelessValidation(const altintegration::PopData& popData, altintegration::ValidationState& state);
+/**
+ * Stateless checks of every payload of popData, unlike popdataStatelessValidation
+ * which stops at the first invalid one. Returns a state per payload, in
+ * validation order: context blocks, then VTBs, then ATVs.
+ */
+std::vector<altintegration::ValidationState> payloadsStatelessValidation(const altintegration::PopData& popData);
 bool addAllBlockPayloads(const CBlock& block, BlockValidationState& state);
+//! Sets alt tree state to block. On failure blocks are marked invalid, and onPopStateChanged() is called.
 bool setState(const uint256& block, altintegration::ValidationState& state);
-
+/**
+ * PoP checks of a block template on top of pindexPrev, which do not add the
+ * template into alt tree. Payloads are checked statelessly, stateful checks
+ * are left to PoP mempool, which selected them. Results are cached per
+ * (pindexPrev, payloads) until onPopStateChanged() is called.
+ */
+bool testBlockPopValidity(const CBlock& block, const CBlockIndex& pindexPrev, BlockValidationState& state);
+
+//! PoP payouts for a child of pindexPrev. Results are cached until onPopStateChanged() is called.
 PoPRewards getPopRewards(const CBlockIndex& pindexPrev, const Consensus::Params& consensusParams);
 void addPopPayoutsIntoCoinbaseTx(CMutableTransaction& coinbaseTx, const CBlockIndex& pindexPrev, const Consensus::Params& consensusParams);
 bool checkCoinbaseTxWithPopRewards(const CTransaction& tx, const CAmount& PoWBlockReward, const CBlockIndex& pindexPrev, const Consensus::Params& consensusParams, BlockValidationState& state);
@@ -41,10 +76,21 @@ std::vector<BlockBytes> getLastKnownVBKBlocks(size_t blocks);
 std::vector<BlockBytes> getLastKnownBTCBlocks(size_t blocks);
 
 //! returns true if all tips are stored in database, false otherwise
-bool hasPopData(CBlockTreeDB& db);
+bool hasPopData(CDBWrapper& db);
 altintegration::PopData getPopData();
-void saveTrees(altintegration::BatchAdaptor& batch);
-bool loadTrees(CDBIterator& iter);
+/**
+ * PoP data for a block on top of tip, at most nMaxSize bytes when serialized.
+ * Candidates are read from PoP mempool again only after the mempool or the
+ * tip change.
+ */
+altintegration::PopData selectPopData(const CBlockIndex& tip, size_t nMaxSize);
+//! number of changes of PoP mempool contents, like CTxMemPool::GetTransactionsUpdated
+uint32_t getPopMempoolUpdated();
+//! writes BTC/VBK/ALT block indices and tips, changed since previous call, and queued PoP storage writes into batch
+void saveTrees(CDBBatch& batch);
+//! called once the batch filled by saveTrees is written, drops queued PoP storage writes it contained
+void onTreesSaved();
+bool loadTrees(CDBWrapper& db);
 
 void updatePopMempoolForReorg();
 
@@ -52,8 +98,16 @@ void addDisconnectedPopdata(const altintegration::PopData& popData);
 
 void removePayloadsFromMempool(const altintegration::PopData& popData);
 
+/**
+ * Compares PoP score of two forks. Results are memoized until onPopStateChanged() is called,
+ * which happens when payloads arrive, when blocks are invalidated or reconsidered, and when
+ * a comparison marks the losing fork invalid.
+ */
 int compareForks(const CBlockIndex& left, const CBlockIndex& right);
 
+//! must be called when payloads or validity of alt blocks change. Drops results which depend on them.
+void onPopStateChanged();
+
 CAmount getCoinbaseSubsidy(const CAmount& subsidy);
 
 } // namespace VeriBlock
@@ -0,0 +1,89 @@
+// Copyright (c) 2019-2020 Xenios SEZC
+// https://www.veriblock.org
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <vbk/pop_stats.hpp>
+
+#include <logging.h>
+#include <sync.h>
+#include <util/time.h>
+
+#include <algorithm>
+#include <iterator>
+#include <cassert>
+
+namespace VeriBlock {
+
+namespace {
+
+Mutex cs_popstats;
+std::array<PopOperationStats, (size_t)PopOperation::COUNT> popStats GUARDED_BY(cs_popstats);
+
+} // namespace
+
+const char* popOperationName(PopOperation op)
+{
+    switch (op) {
+    case PopOperation::ACCEPT_BLOCK_HEADER:
+        return "acceptBlockHeader";
+    case PopOperation::ADD_PAYLOADS:
+        return "addPayloads";
+    case PopOperation::SET_STATE:
+        return "setState";
+    case PopOperation::COMPARE_POP_SCORE:
+        return "comparePopScore";
+    case PopOperation::GET_POP_PAYOUT:
+        return "getPopPayout";
+    case PopOperation::MEMPOOL_SUBMIT:
+        return "mempoolSubmit";
+    case PopOperation::P2P_MESSAGE:
+        return "p2pMessage";
+    case PopOperation::QUEUED_SUBMIT:
+        return "queuedSubmit";
+    case PopOperation::COUNT:
+        break;
+    }
+    return "unknown";
+}
+
+void recordPopOperation(PopOperation op, int64_t nMicros)
+{
+    assert(op < PopOperation::COUNT);
+    const size_t bucket = std::lower_bound(std::begin(POP_STATS_BUCKET_LIMITS), std::end(POP_STATS_BUCKET_LIMITS), nMicros) - std::begin(POP_STATS_BUCKET_LIMITS);
+
+    PopOperationStats snapshot;
+    {
+        LOCK(cs_popstats);
+        auto& stats = popStats[(size_t)op];
+        ++stats.count;
+        stats.totalMicros += nMicros;
+        stats.maxMicros = std::max(stats.maxMicros, nMicros);
+        ++stats.histogram[bucket];
+        snapshot = stats;
+    }
+
+    LogPrint(BCLog::BENCH, "    - PoP %s: %.2fms [%.2fs (%.2fms/op)]\n", popOperationName(op),
+        nMicros * 0.001, snapshot.totalMicros * 0.000001, snapshot.totalMicros * 0.001 / snapshot.count);
+}
+
+std::vector<PopOperationStats> getPopStats()
+{
+    LOCK(cs_popstats);
+    return std::vector<PopOperationStats>(popStats.begin(), popStats.end());
+}
+
+void resetPopStats()
+{
+    LOCK(cs_popstats);
+    popStats.fill(PopOperationStats{});
+}
+
+PopOperationTimer::PopOperationTimer(PopOperation op) : m_op(op), m_start(GetTimeMicros()) {}
+
+PopOperationTimer::~PopOperationTimer()
+{
+    recordPopOperation(m_op, GetTimeMicros() - m_start);
+}
+
+} // namespace VeriBlock
@@ -0,0 +1,69 @@
+// Copyright (c) 2019-2020 Xenios SEZC
+// https://www.veriblock.org
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SRC_VBK_POP_STATS_HPP
+#define BITCOIN_SRC_VBK_POP_STATS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace VeriBlock {
+
+//! Timed operations of the PoP engine
+enum class PopOperation {
+    ACCEPT_BLOCK_HEADER,
+    ADD_PAYLOADS,
+    SET_STATE,
+    COMPARE_POP_SCORE,
+    GET_POP_PAYOUT,
+    MEMPOOL_SUBMIT,
+    P2P_MESSAGE,
+    //! time from queueing payloads with submitpop until they are admitted into PoP mempool
+    QUEUED_SUBMIT,
+    COUNT
+};
+
+//! Number of latency histogram buckets
+static const size_t POP_STATS_BUCKETS = 6;
+//! Upper bounds (inclusive, in microseconds) of latency histogram buckets. Last bucket is unbounded.
+static const int64_t POP_STATS_BUCKET_LIMITS[POP_STATS_BUCKETS - 1] = {100, 1000, 10000, 100000, 1000000};
+
+struct PopOperationStats {
+    uint64_t count{0};
+    int64_t totalMicros{0};
+    int64_t maxMicros{0};
+    std::array<uint64_t, POP_STATS_BUCKETS> histogram{};
+};
+
+const char* popOperationName(PopOperation op);
+
+//! Account a single operation. Logged with -debug=bench.
+void recordPopOperation(PopOperation op, int64_t nMicros);
+
+//! Snapshot of stats, indexed by PopOperation
+std::vector<PopOperationStats> getPopStats();
+
+void resetPopStats();
+
+//! Times its own lifetime as a PoP operation
+class PopOperationTimer
+{
+public:
+    explicit PopOperationTimer(PopOperation op);
+    ~PopOperationTimer();
+
+    PopOperationTimer(const PopOperationTimer&) = delete;
+    PopOperationTimer& operator=(const PopOperationTimer&) = delete;
+
+private:
+    const PopOperation m_op;
+    const int64_t m_start;
+};
+
+} // namespace VeriBlock
+
+#endif //BITCOIN_SRC_VBK_POP_STATS_HPP
@@ -0,0 +1,277 @@
+// Copyright (c) 2019-2020 Xenios SEZC
+// https://www.veriblock.org
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <vbk/pop_submit.hpp>
+
+#include <logging.h>
+#include <util/strencodings.h>
+#include <util/threadnames.h>
+#include <util/time.h>
+#include <validation.h>
+#include <vbk/pop_service.hpp>
+#include <vbk/pop_stats.hpp>
+#include <veriblock/mempool.hpp>
+
+#include <deque>
+#include <map>
+#include <utility>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace VeriBlock {
+
+namespace {
+
+struct QueuedPopData {
+    altintegration::PopData popData;
+    int64_t nTimeQueued;
+};
+
+size_t payloadsCount(const altintegration::PopData& popData)
+{
+    return popData.context.size() + popData.vtbs.size() + popData.atvs.size();
+}
+
+boost::mutex cs_popsubmit;
+boost::condition_variable condPopSubmit;
+std::deque<QueuedPopData> popSubmitQueue;
+PopSubmitQueueStats popSubmitStats;
+struct SubmitResultEntry {
+    PopSubmitResult result;
+    //! sequence number of the latest submission of the payload
+    uint64_t seq;
+};
+
+//! results by handle, and (sequence number, handle) of submissions in the
+//! order they were queued, to evict results of the oldest submissions
+std::map<std::string, SubmitResultEntry> popSubmitResults;
+std::deque<std::pair<uint64_t, std::string>> popSubmitHandles;
+uint64_t popSubmitSeq{0};
+
+//! Starts a new submission of the payload, replacing the result of its previous one
+void addResult(const std::string& handle, const PopSubmitResult& result)
+{
+    const uint64_t seq = ++popSubmitSeq;
+    popSubmitResults[handle] = {result, seq};
+    popSubmitHandles.emplace_back(seq, handle);
+    if (popSubmitHandles.size() > MAX_POP_SUBMIT_RESULTS) {
+        // the payload may have been submitted again since, then its result stays
+        auto it = popSubmitResults.find(popSubmitHandles.front().second);
+        if (it != popSubmitResults.end() && it->second.seq == popSubmitHandles.front().first) {
+            popSubmitResults.erase(it);
+        }
+        popSubmitHandles.pop_front();
+    }
+}
+
+//! Updates the result of the latest submission of the payload, unless it has been evicted
+void setResult(const std::string& handle, const PopSubmitResult& result)
+{
+    auto it = popSubmitResults.find(handle);
+    if (it != popSubmitResults.end()) {
+        it->second.result = result;
+    }
+}
+
+//! Appends handles of payloads
+template <typename pop_t>
+void getHandles(const std::vector<pop_t>& payloads, std::vector<std::string>& handles)
+{
+    for (const auto& payload : payloads) {
+        handles.push_back(HexStr(payload.getId().asVector()));
+    }
+}
+
+void getHandles(const altintegration::PopData& popData, std::vector<std::string>& handles)
+{
+    getHandles(popData.context, handles);
+    getHandles(popData.vtbs, handles);
+    getHandles(popData.atvs, handles);
+}
+
+//! Appends handles of payloads, and drops the ones which are already waiting in the queue
+template <typename pop_t>
+void setQueued(std::vector<pop_t>& payloads, std::vector<std::string>& handles)
+{
+    PopSubmitResult result;
+    result.type = pop_t::name();
+    std::vector<pop_t> queued;
+    queued.reserve(payloads.size());
+    for (auto& payload : payloads) {
+        handles.push_back(HexStr(payload.getId().asVector()));
+        auto it = popSubmitResults.find(handles.back());
+        if (it != popSubmitResults.end() && it->second.result.status == PopSubmitStatus::QUEUED) {
+            continue;
+        }
+        addResult(handles.back(), result);
+        queued.push_back(std::move(payload));
+    }
+    payloads = std::move(queued);
+}
+
+//! Submits payloads which passed stateless checks. i is the index of the first of them in validation order.
+template <typename pop_t>
+void submitPayloads(altintegration::MemPool& mempool, const std::vector<pop_t>& payloads, std::vector<altintegration::ValidationState>& states, std::vector<PopSubmitResult>& results, size_t& i) EXCLUSIVE_LOCKS_REQUIRED(cs_main, cs_popmempool)
+{
+    for (const auto& payload : payloads) {
+        auto& state = states[i];
+        auto& result = results[i++];
+        result.type = pop_t::name();
+        if (state.IsValid() && mempool.submit(payload, state)) {
+            result.status = PopSubmitStatus::ACCEPTED;
+        } else {
+            result.status = PopSubmitStatus::REJECTED;
+            result.reason = state.toString();
+        }
+    }
+}
+
+template <typename pop_t>
+void appendPayloads(std::vector<pop_t>& to, std::vector<pop_t>& from)
+{
+    to.insert(to.end(), std::make_move_iterator(from.begin()), std::make_move_iterator(from.end()));
+}
+
+} // namespace
+
+const char* popSubmitStatusName(PopSubmitStatus status)
+{
+    switch (status) {
+    case PopSubmitStatus::QUEUED:
+        return "queued";
+    case PopSubmitStatus::ACCEPTED:
+        return "accepted";
+    case PopSubmitStatus::REJECTED:
+        return "rejected";
+    }
+    return "unknown";
+}
+
+bool queuePopSubmission(altintegration::PopData popData, std::vector<std::string>& handles)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs_popsubmit);
+        if (popSubmitStats.depth + payloadsCount(popData) > MAX_POP_SUBMIT_QUEUE) {
+            return false;
+        }
+
+        setQueued(popData.context, handles);
+        setQueued(popData.vtbs, handles);
+        setQueued(popData.atvs, handles);
+        const size_t count = payloadsCount(popData);
+        if (count == 0) {
+            return true;
+        }
+        popSubmitStats.depth += count;
+        popSubmitQueue.push_back({std::move(popData), GetTimeMicros()});
+    }
+    condPopSubmit.notify_one();
+    return true;
+}
+
+bool getPopSubmitResult(const std::string& handle, PopSubmitResult& result)
+{
+    boost::unique_lock<boost::mutex> lock(cs_popsubmit);
+    auto it = popSubmitResults.find(handle);
+    if (it == popSubmitResults.end()) {
+        return false;
+    }
+    result = it->second.result;
+    return true;
+}
+
+PopSubmitQueueStats getPopSubmitQueueStats()
+{
+    boost::unique_lock<boost::mutex> lock(cs_popsubmit);
+    return popSubmitStats;
+}
+
+bool processPopSubmissions()
+{
+    // Submissions are merged into a single batch, as long as it fits into
+    // MAX_POP_SUBMIT_BATCH. A larger submission makes a batch on its own.
+    // Payloads are ordered as in a block, so the ones which depend on others,
+    // like VTBs on context blocks, are submitted after them.
+    altintegration::PopData batch;
+    std::vector<int64_t> vTimeQueued;
+    {
+        boost::unique_lock<boost::mutex> lock(cs_popsubmit);
+        size_t count = 0;
+        while (!popSubmitQueue.empty()) {
+            auto& queued = popSubmitQueue.front();
+            const size_t queuedCount = payloadsCount(queued.popData);
+            if (count > 0 && count + queuedCount > MAX_POP_SUBMIT_BATCH) {
+                break;
+            }
+            appendPayloads(batch.context, queued.popData.context);
+            appendPayloads(batch.vtbs, queued.popData.vtbs);
+            appendPayloads(batch.atvs, queued.popData.atvs);
+            vTimeQueued.push_back(queued.nTimeQueued);
+            count += queuedCount;
+            popSubmitQueue.pop_front();
+        }
+        if (vTimeQueued.empty()) {
+            return false;
+        }
+    }
+
+    std::vector<std::string> handles;
+    getHandles(batch, handles);
+
+    const int64_t nTimeStart = GetTimeMicros();
+    std::vector<altintegration::ValidationState> states = payloadsStatelessValidation(batch);
+    const int64_t nTimeChecked = GetTimeMicros();
+
+    std::vector<PopSubmitResult> results(states.size());
+    {
+        LOCK2(cs_main, cs_popmempool);
+        PopOperationTimer timer(PopOperation::MEMPOOL_SUBMIT);
+        auto& mempool = *GetPop().mempool;
+        size_t i = 0;
+        submitPayloads(mempool, batch.context, states, results, i);
+        submitPayloads(mempool, batch.vtbs, states, results, i);
+        submitPayloads(mempool, batch.atvs, states, results, i);
+    }
+    const int64_t nTimeSubmitted = GetTimeMicros();
+    LogPrint(BCLog::BENCH, "    - PoP submission of %u payloads: stateless checks %.2fms, admission %.2fms\n",
+        (unsigned int)results.size(), (nTimeChecked - nTimeStart) * 0.001, (nTimeSubmitted - nTimeChecked) * 0.001);
+
+    {
+        boost::unique_lock<boost::mutex> lock(cs_popsubmit);
+        for (size_t i = 0; i < results.size(); ++i) {
+            if (results[i].status == PopSubmitStatus::ACCEPTED) {
+                ++popSubmitStats.accepted;
+            } else {
+                ++popSubmitStats.rejected;
+            }
+            setResult(handles[i], results[i]);
+        }
+        popSubmitStats.depth -= results.size();
+        ++popSubmitStats.batches;
+    }
+
+    for (int64_t nTimeQueued : vTimeQueued) {
+        recordPopOperation(PopOperation::QUEUED_SUBMIT, nTimeSubmitted - nTimeQueued);
+    }
+    return true;
+}
+
+void ThreadPopSubmit()
+{
+    util::ThreadRename("popsubmit");
+    while (true) {
+        {
+            boost::unique_lock<boost::mutex> lock(cs_popsubmit);
+            while (popSubmitQueue.empty()) {
+                // interruption point
+                condPopSubmit.wait(lock);
+            }
+        }
+        processPopSubmissions();
+    }
+}
+
+} // namespace VeriBlock
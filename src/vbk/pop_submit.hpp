@@ -0,0 +1,78 @@
+// Copyright (c) 2019-2020 Xenios SEZC
+// https://www.veriblock.org
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SRC_VBK_POP_SUBMIT_HPP
+#define BITCOIN_SRC_VBK_POP_SUBMIT_HPP
+
+#include <veriblock/entities/popdata.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace VeriBlock {
+
+//! Maximum number of payloads admitted into PoP mempool while holding cs_main once
+static const size_t MAX_POP_SUBMIT_BATCH = 1000;
+//! Maximum number of payloads waiting in the submission queue
+static const size_t MAX_POP_SUBMIT_QUEUE = 100000;
+//! Number of the most recent submission results, which can be looked up by handle
+static const size_t MAX_POP_SUBMIT_RESULTS = 100000;
+
+enum class PopSubmitStatus {
+    QUEUED,
+    ACCEPTED,
+    REJECTED
+};
+
+const char* popSubmitStatusName(PopSubmitStatus status);
+
+//! Outcome of a queued submission of a single payload
+struct PopSubmitResult {
+    PopSubmitStatus status{PopSubmitStatus::QUEUED};
+    //! name of the payload type, like ATV
+    std::string type;
+    //! reject reason, if rejected
+    std::string reason;
+};
+
+struct PopSubmitQueueStats {
+    //! payloads waiting in the queue or being submitted
+    size_t depth{0};
+    uint64_t batches{0};
+    uint64_t accepted{0};
+    uint64_t rejected{0};
+};
+
+/**
+ * Queue payloads to be added into PoP mempool by the submission thread.
+ * Handles of payloads, which are their hex encoded ids, are appended to
+ * handles in validation order: context blocks, then VTBs, then ATVs.
+ * Payloads already waiting in the queue are not queued again, their
+ * handles refer to the pending submission. A payload submitted again after
+ * it was processed gets a new result under the same handle.
+ * Returns false if the queue has no room for popData.
+ */
+bool queuePopSubmission(altintegration::PopData popData, std::vector<std::string>& handles);
+
+//! Result of a recent queued submission. Returns false if handle is unknown.
+bool getPopSubmitResult(const std::string& handle, PopSubmitResult& result);
+
+PopSubmitQueueStats getPopSubmitQueueStats();
+
+/**
+ * Admit a batch of queued payloads into PoP mempool. Payloads are checked
+ * statelessly without locks, then the valid ones are submitted while holding
+ * cs_main once. Returns false if the queue is empty.
+ */
+bool processPopSubmissions();
+
+/** Run the PoP submission thread, until interrupted */
+void ThreadPopSubmit();
+
+} // namespace VeriBlock
+
+#endif //BITCOIN_SRC_VBK_POP_SUBMIT_HPP
@@ -0,0 +1,201 @@
+// Copyright (c) 2019-2020 Xenios SEZC
+// https://www.veriblock.org
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <util/system.h>
+#include <validation.h>
+#include <vbk/popindex.hpp>
+
+#include <algorithm>
+
+namespace VeriBlock {
+
+constexpr char DB_POPINDEX = 'p';
+
+std::unique_ptr<PopIndex> g_popindex;
+
+namespace {
+
+struct CDiskPopPos : public FlatFilePos {
+    unsigned int nPayloadOffset; // after header
+    unsigned int nPayloadSize;   // of the payload VBK encoding
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITEAS(FlatFilePos, *this);
+        READWRITE(VARINT(nPayloadOffset));
+        READWRITE(VARINT(nPayloadSize));
+    }
+
+    CDiskPopPos(const FlatFilePos& blockIn, unsigned int nPayloadOffsetIn, unsigned int nPayloadSizeIn) : FlatFilePos(blockIn.nFile, blockIn.nPos), nPayloadOffset(nPayloadOffsetIn), nPayloadSize(nPayloadSizeIn)
+    {
+    }
+
+    CDiskPopPos()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        FlatFilePos::SetNull();
+        nPayloadOffset = 0;
+        nPayloadSize = 0;
+    }
+};
+
+// payload types share the index, keys are prefixed with a type tag
+template <typename pop_t>
+char PayloadTag();
+
+template <>
+char PayloadTag<altintegration::ATV>()
+{
+    return 'a';
+}
+
+template <>
+char PayloadTag<altintegration::VTB>()
+{
+    return 't';
+}
+
+template <>
+char PayloadTag<altintegration::VbkBlock>()
+{
+    return 'v';
+}
+
+template <typename pop_t>
+std::pair<char, std::pair<char, std::vector<uint8_t>>> PayloadKey(const typename pop_t::id_t& id)
+{
+    return std::make_pair(DB_POPINDEX, std::make_pair(PayloadTag<pop_t>(), id.asVector()));
+}
+
+} // namespace
+
+/**
+ * Access to the popindex database (indexes/popindex/)
+ */
+class PopIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    /// Read the disk location of the payload with the given id. Returns false
+    /// if the payload is not indexed.
+    template <typename pop_t>
+    bool ReadPayloadPos(const typename pop_t::id_t& id, CDiskPopPos& pos) const
+    {
+        return Read(PayloadKey<pop_t>(id), pos);
+    }
+
+    /// Write positions of all payloads of a block to the DB. popData is
+    /// stored at nPopOffset after the block header, in its VBK encoding.
+    bool WritePayloads(const altintegration::PopData& popData, const FlatFilePos& blockPos, unsigned int nPopOffset);
+
+private:
+    template <typename pop_t>
+    void WritePayloads(CDBBatch& batch, const std::vector<pop_t>& payloads, const std::vector<uint8_t>& encoded, const FlatFilePos& blockPos, unsigned int nPopOffset)
+    {
+        // payloads are written one after another in the encoding of PopData,
+        // so each is searched for after the previous one
+        auto from = encoded.begin();
+        for (const auto& payload : payloads) {
+            altintegration::WriteStream stream;
+            payload.toVbkEncoding(stream);
+            const auto& bytes = stream.data();
+            auto it = std::search(from, encoded.end(), bytes.begin(), bytes.end());
+            if (it == encoded.end()) {
+                // not indexed, lookups fall back to the block
+                continue;
+            }
+            batch.Write(PayloadKey<pop_t>(payload.getId()), CDiskPopPos(blockPos, nPopOffset + (it - encoded.begin()), bytes.size()));
+            from = it + bytes.size();
+        }
+    }
+};
+
+PopIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) : BaseIndex::DB(GetDataDir() / "indexes" / "popindex", n_cache_size, f_memory, f_wipe)
+{
+}
+
+bool PopIndex::DB::WritePayloads(const altintegration::PopData& popData, const FlatFilePos& blockPos, unsigned int nPopOffset)
+{
+    // PopData is serialized as a vector of its VBK encoding, see serialize.h
+    const std::vector<uint8_t> encoded = popData.toVbkEncoding();
+    nPopOffset += GetSizeOfCompactSize(encoded.size());
+
+    CDBBatch batch(*this);
+    WritePayloads(batch, popData.context, encoded, blockPos, nPopOffset);
+    WritePayloads(batch, popData.vtbs, encoded, blockPos, nPopOffset);
+    WritePayloads(batch, popData.atvs, encoded, blockPos, nPopOffset);
+    return WriteBatch(batch);
+}
+
+PopIndex::PopIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<PopIndex::DB>(n_cache_size, f_memory, f_wipe))
+{
+}
+
+PopIndex::~PopIndex() {}
+
+bool PopIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    if (!(block.nVersion & POP_BLOCK_VERSION_BIT)) return true;
+    if (block.popData.context.empty() && block.popData.vtbs.empty() && block.popData.atvs.empty()) return true;
+
+    const unsigned int nPopOffset = ::GetSerializeSize(block.vtx, CLIENT_VERSION);
+    return m_db->WritePayloads(block.popData, pindex->GetBlockPos(), nPopOffset);
+}
+
+BaseIndex::DB& PopIndex::GetDB() const { return *m_db; }
+
+template <typename pop_t>
+bool PopIndex::FindPayload(const typename pop_t::id_t& id, pop_t& out, uint256& block_hash) const
+{
+    CDiskPopPos pos;
+    if (!m_db->ReadPayloadPos<pop_t>(id, pos)) {
+        return false;
+    }
+
+    CAutoFile file(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        return error("%s: OpenBlockFile failed", __func__);
+    }
+    CBlockHeader header;
+    std::vector<uint8_t> bytes(pos.nPayloadSize);
+    try {
+        file >> header;
+        if (fseek(file.Get(), pos.nPayloadOffset, SEEK_CUR)) {
+            return error("%s: fseek(...) failed", __func__);
+        }
+        file.read((char*)bytes.data(), bytes.size());
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+
+    pop_t payload;
+    try {
+        altintegration::ReadStream stream(bytes);
+        payload = pop_t::fromVbkEncoding(stream);
+    } catch (const std::exception& e) {
+        return error("%s: %s decode error - %s", __func__, pop_t::name(), e.what());
+    }
+    if (payload.getId() != id) {
+        return error("%s: %s id mismatch", __func__, pop_t::name());
+    }
+    out = payload;
+    block_hash = header.GetHash();
+    return true;
+}
+
+template bool PopIndex::FindPayload<altintegration::ATV>(const altintegration::ATV::id_t& id, altintegration::ATV& out, uint256& block_hash) const;
+template bool PopIndex::FindPayload<altintegration::VTB>(const altintegration::VTB::id_t& id, altintegration::VTB& out, uint256& block_hash) const;
+template bool PopIndex::FindPayload<altintegration::VbkBlock>(const altintegration::VbkBlock::id_t& id, altintegration::VbkBlock& out, uint256& block_hash) const;
+
+} // namespace VeriBlock
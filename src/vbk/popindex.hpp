@@ -0,0 +1,64 @@
+// Copyright (c) 2019-2020 Xenios SEZC
+// https://www.veriblock.org
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SRC_VBK_POPINDEX_HPP
+#define BITCOIN_SRC_VBK_POPINDEX_HPP
+
+#include <chain.h>
+#include <index/base.h>
+
+#include <veriblock/entities/atv.hpp>
+#include <veriblock/entities/vbkblock.hpp>
+#include <veriblock/entities/vtb.hpp>
+
+namespace VeriBlock {
+
+//! -popindex default
+static const bool DEFAULT_POPINDEX = false;
+
+/**
+ * PopIndex is used to look up ATVs, VTBs and VBK blocks included in the
+ * blockchain by id. The index is written to a LevelDB database and records
+ * the filesystem location of the containing block, and the offset and size
+ * of the payload in it, so that only the payload itself is read and decoded.
+ */
+class PopIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "popindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit PopIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~PopIndex() override;
+
+    /// Look up a payload by id.
+    ///
+    /// @param[in]   id  The id of the payload to be returned.
+    /// @param[out]  out  The payload itself.
+    /// @param[out]  block_hash  The hash of the block the payload is found in.
+    /// @return  true if payload is found, false otherwise
+    template <typename pop_t>
+    bool FindPayload(const typename pop_t::id_t& id, pop_t& out, uint256& block_hash) const;
+};
+
+/// The global PoP payload index, used in getrawatv/getrawvtb/getrawvbkblock. May be null.
+extern std::unique_ptr<PopIndex> g_popindex;
+
+} // namespace VeriBlock
+
+#endif // BITCOIN_SRC_VBK_POPINDEX_HPP
@@ -7,8 +7,11 @@
 #include <consensus/merkle.h>
 #include <rpc/server.h>
 #include <rpc/util.h>
+#include <txdb.h>
+#include <util/time.h>
 #include <util/validation.h>
 #include <validation.h>
+#include <validationinterface.h>
 #include <vbk/entity/context_info_container.hpp>
 #include <vbk/p2p_sync.hpp>
 #include <wallet/rpcwallet.h>
@@ -16,10 +19,15 @@
 
 #include <fstream>
 #include <set>
+#include <sstream>
 
 #include <vbk/adaptors/univalue_json.hpp>
 #include <vbk/merkle.hpp>
+#include <vbk/pop_db.hpp>
 #include <vbk/pop_service.hpp>
+#include <vbk/pop_stats.hpp>
+#include <vbk/pop_submit.hpp>
+#include <vbk/popindex.hpp>
 #include <veriblock/mempool_result.hpp>
 #include "rpc_register.hpp"
 
@@ -54,6 +62,187 @@ CBlock GetBlockChecked(const CBlockIndex* pblockindex)
     return block;
 }
 
+//! number of last known VBK and BTC blocks returned by getpopdata
+const size_t POP_DATA_LAST_KNOWN_BLOCKS = 16;
+//! upper bound on the number of heights in a getpopdatarange call
+const int MAX_POP_DATA_RANGE = 1000;
+//! upper bound on the number of cached transaction merkle roots
+const size_t MAX_CACHED_TX_ROOTS = 10000;
+
+/**
+ * getpopdata results for the tip last announced by UpdatedBlockTip, and the
+ * last known VBK/BTC blocks at that tip. Results computed at any other tip
+ * are not cached, and are not served until the callback for the active tip
+ * is delivered. The active tip is read from g_best_block, so cache hits do
+ * not take cs_main. Transaction merkle roots do not depend on the tip and are
+ * kept, so every block is read from disk once.
+ */
+class PopDataCache final : public CValidationInterface
+{
+public:
+    //! tip is the active tip, entries cached for any other tip are not used
+    bool Get(const uint256& tip, int height, UniValue& result) const
+    {
+        LOCK(cs);
+        if (tip != m_tip) {
+            return false;
+        }
+        auto it = m_entries.find(height);
+        if (it == m_entries.end()) {
+            return false;
+        }
+        result = it->second;
+        return true;
+    }
+
+    void Put(const uint256& tip, int height, const UniValue& result)
+    {
+        LOCK(cs);
+        if (tip == m_tip) {
+            m_entries[height] = result;
+        }
+    }
+
+    bool GetLastKnownBlocks(const uint256& tip, UniValue& vbk, UniValue& btc) const
+    {
+        LOCK(cs);
+        if (tip != m_tip || m_lastVbkBlocks.isNull()) {
+            return false;
+        }
+        vbk = m_lastVbkBlocks;
+        btc = m_lastBtcBlocks;
+        return true;
+    }
+
+    void PutLastKnownBlocks(const uint256& tip, const UniValue& vbk, const UniValue& btc)
+    {
+        LOCK(cs);
+        if (tip == m_tip) {
+            m_lastVbkBlocks = vbk;
+            m_lastBtcBlocks = btc;
+        }
+    }
+
+    bool GetTxRoot(const uint256& block, uint256& root) const
+    {
+        LOCK(cs);
+        auto it = m_txRoots.find(block);
+        if (it == m_txRoots.end()) {
+            return false;
+        }
+        root = it->second;
+        return true;
+    }
+
+    //! the cache is registered after the block chain is loaded, when no UpdatedBlockTip is pending
+    void SetTip(const uint256& tip)
+    {
+        LOCK(cs);
+        m_tip = tip;
+    }
+
+    void PutTxRoot(const uint256& block, const uint256& root)
+    {
+        LOCK(cs);
+        if (m_txRoots.size() >= MAX_CACHED_TX_ROOTS) {
+            m_txRoots.clear();
+        }
+        m_txRoots.emplace(block, root);
+    }
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload) override
+    {
+        LOCK(cs);
+        m_tip = pindexNew->GetBlockHash();
+        m_entries.clear();
+        m_lastVbkBlocks.setNull();
+        m_lastBtcBlocks.setNull();
+    }
+
+private:
+    mutable Mutex cs;
+    uint256 m_tip GUARDED_BY(cs);
+    std::map<int, UniValue> m_entries GUARDED_BY(cs);
+    UniValue m_lastVbkBlocks GUARDED_BY(cs);
+    UniValue m_lastBtcBlocks GUARDED_BY(cs);
+    std::map<uint256, uint256> m_txRoots GUARDED_BY(cs);
+};
+
+PopDataCache popDataCache;
+
+UniValue BlocksToUniValue(const std::vector<BlockBytes>& blocks)
+{
+    UniValue result(UniValue::VARR);
+    for (const auto& b : blocks) {
+        result.push_back(HexStr(b));
+    }
+    return result;
+}
+
+//! hash of the active tip, read without cs_main once a block has been connected
+uint256 GetActiveTipHash()
+{
+    {
+        LOCK(g_best_block_mutex);
+        if (!g_best_block.IsNull()) {
+            return g_best_block;
+        }
+    }
+    // no block has been connected since startup
+    LOCK(cs_main);
+    return ChainActive().Tip()->GetBlockHash();
+}
+
+//! getpopdata result for the block at height in the active chain
+UniValue GetPopDataForHeight(int height)
+{
+    UniValue result(UniValue::VOBJ);
+    if (popDataCache.Get(GetActiveTipHash(), height, result)) {
+        return result;
+    }
+
+    LOCK(cs_main);
+    const uint256 tip = ChainActive().Tip()->GetBlockHash();
+
+    uint256 blockhash = GetBlockHashByHeight(height);
+
+    //get the block and its header
+    const CBlockIndex* pBlockIndex = LookupBlockIndex(blockhash);
+
+    if (!pBlockIndex) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+    }
+
+    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+    ssBlock << pBlockIndex->GetBlockHeader();
+    result.pushKV("block_header", HexStr(ssBlock));
+
+    //context info
+    uint256 txRoot;
+    if (!popDataCache.GetTxRoot(blockhash, txRoot)) {
+        txRoot = BlockMerkleRoot(GetBlockChecked(pBlockIndex));
+        popDataCache.PutTxRoot(blockhash, txRoot);
+    }
+    auto keystones = VeriBlock::getKeystoneHashesForTheNextBlock(pBlockIndex->pprev);
+    auto contextInfo = VeriBlock::ContextInfoContainer(pBlockIndex->nHeight, keystones, txRoot);
+    auto authedContext = contextInfo.getAuthenticated();
+    result.pushKV("raw_contextinfocontainer", HexStr(authedContext.begin(), authedContext.end()));
+
+    UniValue univalueLastVBKBlocks;
+    UniValue univalueLastBTCBlocks;
+    if (!popDataCache.GetLastKnownBlocks(tip, univalueLastVBKBlocks, univalueLastBTCBlocks)) {
+        univalueLastVBKBlocks = BlocksToUniValue(VeriBlock::getLastKnownVBKBlocks(POP_DATA_LAST_KNOWN_BLOCKS));
+        univalueLastBTCBlocks = BlocksToUniValue(VeriBlock::getLastKnownBTCBlocks(POP_DATA_LAST_KNOWN_BLOCKS));
+        popDataCache.PutLastKnownBlocks(tip, univalueLastVBKBlocks, univalueLastBTCBlocks);
+    }
+    result.pushKV("last_known_veriblock_blocks", univalueLastVBKBlocks);
+    result.pushKV("last_known_bitcoin_blocks", univalueLastBTCBlocks);
+
+    popDataCache.Put(tip, height, result);
+    return result;
+}
+
 } // namespace
 
 UniValue getpopdata(const JSONRPCRequest& request)
@@ -87,49 +276,47 @@ UniValue getpopdata(const JSONRPCRequest& request)
     // the user could have gotten from another RPC command prior to now
     wallet->BlockUntilSyncedToCurrentChain();
 
-    int height = request.params[0].get_int();
-
-    LOCK2(cs_main, wallet->cs_wallet);
-
-    uint256 blockhash = GetBlockHashByHeight(height);
-
-    UniValue result(UniValue::VOBJ);
+    return GetPopDataForHeight(request.params[0].get_int());
+}
 
-    //get the block and its header
-    const CBlockIndex* pBlockIndex = LookupBlockIndex(blockhash);
+UniValue getpopdatarange(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 2)
+        throw std::runtime_error(
+            "getpopdatarange first_height last_height\n"
+            "\nFetches the data relevant to PoP-mining the blocks at the given heights, like getpopdata.\n"
+            "Every height is read separately, so results may span a tip change.\n"
+            "\nArguments:\n"
+            "1. first_height         (numeric, required) The first height index\n"
+            "2. last_height          (numeric, required) The last height index, at most " + std::to_string(MAX_POP_DATA_RANGE - 1) + " above first_height\n"
+            "\nResult:\n"
+            "[\n"
+            "    { ... },            (json object) getpopdata result for every height, in order\n"
+            "    ...\n"
+            "]\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getpopdatarange", "1000 1100") + HelpExampleRpc("getpopdatarange", "1000, 1100"));
 
-    if (!pBlockIndex) {
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+    auto wallet = GetWalletForJSONRPCRequest(request);
+    if (!EnsureWalletIsAvailable(wallet.get(), request.fHelp)) {
+        return NullUniValue;
     }
 
-    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-    ssBlock << pBlockIndex->GetBlockHeader();
-    result.pushKV("block_header", HexStr(ssBlock));
-
-    auto block = GetBlockChecked(pBlockIndex);
-
-    //context info
-    uint256 txRoot = BlockMerkleRoot(block);
-    auto keystones = VeriBlock::getKeystoneHashesForTheNextBlock(pBlockIndex->pprev);
-    auto contextInfo = VeriBlock::ContextInfoContainer(pBlockIndex->nHeight, keystones, txRoot);
-    auto authedContext = contextInfo.getAuthenticated();
-    result.pushKV("raw_contextinfocontainer", HexStr(authedContext.begin(), authedContext.end()));
-
-    auto lastVBKBlocks = VeriBlock::getLastKnownVBKBlocks(16);
+    wallet->BlockUntilSyncedToCurrentChain();
 
-    UniValue univalueLastVBKBlocks(UniValue::VARR);
-    for (const auto& b : lastVBKBlocks) {
-        univalueLastVBKBlocks.push_back(HexStr(b));
+    const int first = request.params[0].get_int();
+    const int last = request.params[1].get_int();
+    if (first < 0 || last < first) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid height range");
     }
-    result.pushKV("last_known_veriblock_blocks", univalueLastVBKBlocks);
-
-    auto lastBTCBlocks = VeriBlock::getLastKnownBTCBlocks(16);
-    UniValue univalueLastBTCBlocks(UniValue::VARR);
-    for (const auto& b : lastBTCBlocks) {
-        univalueLastBTCBlocks.push_back(HexStr(b));
+    if (last - first >= MAX_POP_DATA_RANGE) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Range is limited to %d heights", MAX_POP_DATA_RANGE));
     }
-    result.pushKV("last_known_bitcoin_blocks", univalueLastBTCBlocks);
 
+    UniValue result(UniValue::VARR);
+    for (int height = first; height <= last; ++height) {
+        result.push_back(GetPopDataForHeight(height));
+    }
     return result;
 }
 
@@ -150,38 +337,143 @@ std::vector<pop_t> parsePayloads(const UniValue& array)
     return payloads;
 }
 
+template <typename pop_t>
+UniValue handlesToUniValue(std::vector<std::string>::const_iterator& handle, const std::vector<pop_t>& payloads)
+{
+    UniValue result(UniValue::VARR);
+    for (size_t i = 0; i < payloads.size(); ++i) {
+        result.push_back(*handle++);
+    }
+    return result;
+}
+
 UniValue submitpop(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() > 3)
+    if (request.fHelp || request.params.size() < 3 || request.params.size() > 4)
         throw std::runtime_error(
-            "submitpop [vbk_blocks] [vtbs] [atvs]\n"
+            "submitpop [vbk_blocks] [vtbs] [atvs] ( async )\n"
             "\nCreates and submits a PoP transaction constructed from the provided ATV and VTBs.\n"
             "\nArguments:\n"
             "1. vbk_blocks      (array, required) Array of hex-encoded VbkBlocks records.\n"
             "2. vtbs      (array, required) Array of hex-encoded VTB records.\n"
             "3. atvs      (array, required) Array of hex-encoded ATV records.\n"
+            "4. async     (boolean, optional, default=false) Queue payloads and return without waiting for PoP mempool.\n"
+            "             Results are looked up with getpopsubmitresult.\n"
             "\nResult:\n"
             "             (string) MempoolResult\n"
+            "\nResult (async):\n"
+            "{\n"
+            "  \"vbkblocks\" : [ \"handle\", ... ],   (array) handles of VBK blocks, in order of vbk_blocks\n"
+            "  \"vtbs\" : [ \"handle\", ... ],        (array) handles of VTBs, in order of vtbs\n"
+            "  \"atvs\" : [ \"handle\", ... ]         (array) handles of ATVs, in order of atvs\n"
+            "}\n"
             "\nExamples:\n" +
-            HelpExampleCli("submitpop", " [VBK_HEX VBK_HEX] [VTB_HEX VTB_HEX] [ATV_HEX ATV_HEX]") + HelpExampleRpc("submitpop", "[VBK_HEX] [] [ATV_HEX ATV_HEX]"));
+            HelpExampleCli("submitpop", " [VBK_HEX VBK_HEX] [VTB_HEX VTB_HEX] [ATV_HEX ATV_HEX]") + HelpExampleRpc("submitpop", "[VBK_HEX] [] [ATV_HEX ATV_HEX]") +
+            HelpExampleCli("submitpop", " [VBK_HEX] [VTB_HEX] [] true"));
 
-    RPCTypeCheck(request.params, {UniValue::VARR, UniValue::VARR, UniValue::VARR});
+    RPCTypeCheck(request.params, {UniValue::VARR, UniValue::VARR, UniValue::VARR, UniValue::VBOOL});
 
     altintegration::PopData popData;
     popData.context = parsePayloads<altintegration::VbkBlock>(request.params[0].get_array());
     popData.vtbs = parsePayloads<altintegration::VTB>(request.params[1].get_array());
     popData.atvs = parsePayloads<altintegration::ATV>(request.params[2].get_array());
 
+    if (!request.params[3].isNull() && request.params[3].get_bool()) {
+        std::vector<std::string> handles;
+        if (!queuePopSubmission(popData, handles)) {
+            throw JSONRPCError(RPC_OUT_OF_MEMORY, "PoP submission queue is full");
+        }
+
+        auto handle = handles.cbegin();
+        UniValue result(UniValue::VOBJ);
+        result.pushKV("vbkblocks", handlesToUniValue(handle, popData.context));
+        result.pushKV("vtbs", handlesToUniValue(handle, popData.vtbs));
+        result.pushKV("atvs", handlesToUniValue(handle, popData.atvs));
+        return result;
+    }
+
     {
-        LOCK(cs_main);
+        LOCK2(cs_main, VeriBlock::cs_popmempool);
         auto& pop_mempool = *VeriBlock::GetPop().mempool;
 
+        int64_t nTimeStart = GetTimeMicros();
         altintegration::MempoolResult result = pop_mempool.submitAll(popData);
+        recordPopOperation(PopOperation::MEMPOOL_SUBMIT, GetTimeMicros() - nTimeStart);
 
         return altintegration::ToJSON<UniValue>(result);
     }
 }
 
+UniValue getpopsubmitresult(const JSONRPCRequest& request)
+{
+    auto cmdname = "getpopsubmitresult";
+    RPCHelpMan{
+        cmdname,
+        "\nReturns the outcome of a payload queued with submitpop in async mode.\n"
+        "Results of the most recent " + std::to_string(MAX_POP_SUBMIT_RESULTS) + " payloads are kept.\n",
+        {
+            {"handle", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "Handle returned by submitpop"},
+        },
+        RPCResult{
+            "{\n"
+            "  \"status\" : \"xxx\",      (string) queued, accepted or rejected\n"
+            "  \"type\" : \"xxx\",        (string) payload type\n"
+            "  \"reason\" : \"xxx\"       (string, optional) reject reason\n"
+            "}\n"},
+        RPCExamples{
+            HelpExampleCli(cmdname, "\"handle\"") +
+            HelpExampleRpc(cmdname, "\"handle\"")},
+    }
+        .Check(request);
+
+    PopSubmitResult submitResult;
+    if (!getPopSubmitResult(request.params[0].get_str(), submitResult)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown or expired handle");
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("status", popSubmitStatusName(submitResult.status));
+    result.pushKV("type", submitResult.type);
+    if (submitResult.status == PopSubmitStatus::REJECTED) {
+        result.pushKV("reason", submitResult.reason);
+    }
+    return result;
+}
+
+UniValue getpopsubmitqueueinfo(const JSONRPCRequest& request)
+{
+    auto cmdname = "getpopsubmitqueueinfo";
+    RPCHelpMan{
+        cmdname,
+        "\nReturns the state of the queue of payloads submitted with submitpop in async mode.\n"
+        "Latency of queued submissions is reported by getpopstats as queuedSubmit.\n",
+        {},
+        RPCResult{
+            "{\n"
+            "  \"depth\" : n,           (numeric) payloads waiting in the queue or being submitted\n"
+            "  \"max_depth\" : n,       (numeric) payloads the queue can hold\n"
+            "  \"max_batch\" : n,       (numeric) payloads admitted into PoP mempool at once\n"
+            "  \"batches\" : n,         (numeric) batches processed since startup\n"
+            "  \"accepted\" : n,        (numeric) payloads accepted since startup\n"
+            "  \"rejected\" : n         (numeric) payloads rejected since startup\n"
+            "}\n"},
+        RPCExamples{
+            HelpExampleCli(cmdname, "") +
+            HelpExampleRpc(cmdname, "")},
+    }
+        .Check(request);
+
+    const auto stats = getPopSubmitQueueStats();
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("depth", (uint64_t)stats.depth);
+    result.pushKV("max_depth", (uint64_t)MAX_POP_SUBMIT_QUEUE);
+    result.pushKV("max_batch", (uint64_t)MAX_POP_SUBMIT_BATCH);
+    result.pushKV("batches", stats.batches);
+    result.pushKV("accepted", stats.accepted);
+    result.pushKV("rejected", stats.rejected);
+    return result;
+}
+
 UniValue debugpop(const JSONRPCRequest& request)
 {
     if (request.fHelp) {
@@ -380,16 +672,121 @@ UniValue getrawpopmempool(const JSONRPCRequest& request)
     }
         .Check(request);
 
+    LOCK(VeriBlock::cs_popmempool);
     auto& mp = *VeriBlock::GetPop().mempool;
     return altintegration::ToJSON<UniValue>(mp);
 }
 
-} // namespace
+UniValue getpopstats(const JSONRPCRequest& request)
+{
+    auto cmdname = "getpopstats";
+    RPCHelpMan{
+        cmdname,
+        "\nReturns counters and latencies of PoP engine operations since startup or the last reset.\n",
+        {
+            {"reset", RPCArg::Type::BOOL, /* default */ "false", "Reset counters after they are returned"},
+        },
+        RPCResult{
+            "{\n"
+            "  \"operation\" : {            (json object) one entry per operation, e.g. addPayloads, mempoolSubmit, p2pMessage\n"
+            "    \"count\" : n,             (numeric) number of times the operation ran\n"
+            "    \"total_ms\" : x.xxx,      (numeric) total time spent in the operation\n"
+            "    \"avg_ms\" : x.xxx,        (numeric) average latency\n"
+            "    \"max_ms\" : x.xxx,        (numeric) maximum latency\n"
+            "    \"histogram\" : {          (json object) number of operations by latency\n"
+            "      \"le_0.1ms\" : n,\n"
+            "      ...\n"
+            "      \"gt_1000ms\" : n\n"
+            "    }\n"
+            "  },\n"
+            "  ...\n"
+            "}\n"},
+        RPCExamples{
+            HelpExampleCli(cmdname, "") +
+            HelpExampleRpc(cmdname, "")},
+    }
+        .Check(request);
 
-// getrawatv
-// getrawvtb
-// getrawvbkblock
-namespace {
+    const auto stats = getPopStats();
+    if (!request.params[0].isNull() && request.params[0].get_bool()) {
+        resetPopStats();
+    }
+
+    UniValue result(UniValue::VOBJ);
+    for (size_t op = 0; op < stats.size(); ++op) {
+        const auto& s = stats[op];
+        UniValue histogram(UniValue::VOBJ);
+        for (size_t i = 0; i < POP_STATS_BUCKETS; ++i) {
+            const std::string label = i + 1 < POP_STATS_BUCKETS ?
+                                          strprintf("le_%gms", POP_STATS_BUCKET_LIMITS[i] * 0.001) :
+                                          strprintf("gt_%gms", POP_STATS_BUCKET_LIMITS[i - 1] * 0.001);
+            histogram.pushKV(label, s.histogram[i]);
+        }
+
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("count", s.count);
+        entry.pushKV("total_ms", s.totalMicros * 0.001);
+        entry.pushKV("avg_ms", s.count == 0 ? 0.0 : s.totalMicros * 0.001 / s.count);
+        entry.pushKV("max_ms", s.maxMicros * 0.001);
+        entry.pushKV("histogram", histogram);
+        result.pushKV(popOperationName((PopOperation)op), entry);
+    }
+    return result;
+}
+
+UniValue dbStats(const CDBWrapper& db)
+{
+    UniValue result(UniValue::VOBJ);
+    std::string stats;
+    if (db.GetProperty("leveldb.stats", stats)) {
+        UniValue lines(UniValue::VARR);
+        std::istringstream stream(stats);
+        std::string line;
+        while (std::getline(stream, line)) {
+            if (!line.empty()) {
+                lines.push_back(line);
+            }
+        }
+        result.pushKV("compactions", lines);
+    }
+    std::string memory;
+    if (db.GetProperty("leveldb.approximate-memory-usage", memory)) {
+        result.pushKV("memory_bytes", memory);
+    }
+    return result;
+}
+
+UniValue getpopdbstats(const JSONRPCRequest& request)
+{
+    auto cmdname = "getpopdbstats";
+    RPCHelpMan{
+        cmdname,
+        "\nReturns LevelDB compaction statistics of the databases storing PoP data.\n",
+        {},
+        RPCResult{
+            "{\n"
+            "  \"blocktree\" : {           (json object) block index database\n"
+            "    \"compactions\" : [ ... ], (json array of string) per level table of files, size and compaction time, as reported by LevelDB\n"
+            "    \"memory_bytes\" : \"n\"    (string) approximate memory used by the database\n"
+            "  },\n"
+            "  \"pop\" : { ... }           (json object) the same for the PoP database, if -popdb is set\n"
+            "}\n"},
+        RPCExamples{
+            HelpExampleCli(cmdname, "") +
+            HelpExampleRpc(cmdname, "")},
+    }
+        .Check(request);
+
+    LOCK(cs_main);
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("blocktree", dbStats(*pblocktree));
+    if (g_popdb) {
+        result.pushKV("pop", dbStats(*g_popdb));
+    }
+    return result;
+}
+
+} // namespace
 
 template <typename T>
 bool GetPayload(
@@ -399,9 +796,8 @@ bool GetPayload(
   const CBlockIndex* const block_index,
   std::vector<uint256>& containingBlocks)
 {
-    LOCK(cs_main);
-
     if (block_index) {
+        LOCK(cs_main);
         CBlock block;
         if (!ReadBlockFromDisk(block, block_index, consensusParams)) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
@@ -416,13 +812,24 @@ bool GetPayload(
 
     auto& pop = VeriBlock::GetPop();
 
-    auto& mp = *pop.mempool;
-    auto* pl = mp.get<T>(pid);
-    if (pl) {
-        out = *pl;
+    {
+        LOCK(VeriBlock::cs_popmempool);
+        auto& mp = *pop.mempool;
+        auto* pl = mp.get<T>(pid);
+        if (pl) {
+            out = *pl;
+            return true;
+        }
+    }
+
+    // popindex reads the payload straight from the block file, without cs_main
+    uint256 indexedBlock;
+    if (VeriBlock::g_popindex && VeriBlock::g_popindex->FindPayload<T>(pid, out, indexedBlock)) {
+        containingBlocks.push_back(indexedBlock);
         return true;
     }
 
+    LOCK(cs_main);
     // search in the alttree storage
     const auto& containing = pop.altTree->getStorage().getContainingAltBlocks(pid.asVector());
     if (containing.size() == 0) return false;
@@ -434,8 +841,8 @@ bool GetPayload(
             return uint256(blockHash);
         });
 
-    for (const auto& blockHash : containing) {
-        auto* index = LookupBlockIndex(uint256(blockHash));
+    for (const auto& blockHash : containingBlocks) {
+        auto* index = LookupBlockIndex(blockHash);
         assert(index && "state and index mismatch");
 
         CBlock block;
@@ -451,6 +858,15 @@ bool GetPayload(
     return true;
 }
 
+template bool GetPayload(const altintegration::ATV::id_t&, altintegration::ATV&, const Consensus::Params&, const CBlockIndex* const, std::vector<uint256>&);
+template bool GetPayload(const altintegration::VTB::id_t&, altintegration::VTB&, const Consensus::Params&, const CBlockIndex* const, std::vector<uint256>&);
+template bool GetPayload(const altintegration::VbkBlock::id_t&, altintegration::VbkBlock&, const Consensus::Params&, const CBlockIndex* const, std::vector<uint256>&);
+
+// getrawatv
+// getrawvtb
+// getrawvbkblock
+namespace {
+
 template <typename T>
 UniValue getrawpayload(const JSONRPCRequest& request, const std::string& name)
 {
@@ -585,8 +1001,11 @@ UniValue getrawvbkblock(const JSONRPCRequest& req)
 } // namespace
 
 const CRPCCommand commands[] = {
-    {"pop_mining", "submitpop", &submitpop, {"atv", "vtbs"}},
+    {"pop_mining", "submitpop", &submitpop, {"vbk_blocks", "vtbs", "atvs", "async"}},
+    {"pop_mining", "getpopsubmitresult", &getpopsubmitresult, {"handle"}},
+    {"pop_mining", "getpopsubmitqueueinfo", &getpopsubmitqueueinfo, {}},
     {"pop_mining", "getpopdata", &getpopdata, {"blockheight"}},
+    {"pop_mining", "getpopdatarange", &getpopdatarange, {"first_height", "last_height"}},
     {"pop_mining", "debugpop", &debugpop, {}},
     {"pop_mining", "getvbkblock", &getvbkblock, {"hash"}},
     {"pop_mining", "getbtcblock", &getbtcblock, {"hash"}},
@@ -597,7 +1016,25 @@ const CRPCCommand commands[] = {
     {"pop_mining", "getrawatv", &getrawatv, {"id"}},
     {"pop_mining", "getrawvtb", &getrawvtb, {"id"}},
     {"pop_mining", "getrawvbkblock", &getrawvbkblock, {"id"}},
-    {"pop_mining", "getrawpopmempool", &getrawpopmempool, {}}};
+    {"pop_mining", "getrawpopmempool", &getrawpopmempool, {}},
+    {"pop_mining", "getpopstats", &getpopstats, {"reset"}},
+    {"pop_mining", "getpopdbstats", &getpopdbstats, {}}};
+
+void RegisterPopDataCache()
+{
+    {
+        LOCK(cs_main);
+        if (ChainActive().Tip() != nullptr) {
+            popDataCache.SetTip(ChainActive().Tip()->GetBlockHash());
+        }
+    }
+    RegisterValidationInterface(&popDataCache);
+}
+
+void UnregisterPopDataCache()
+{
+    UnregisterValidationInterface(&popDataCache);
+}
 
 void RegisterPOPMiningRPCCommands(CRPCTable& t)
 {
@@ -6,12 +6,34 @@
 #ifndef BITCOIN_SRC_VBK_RPC_REGISTER_HPP
 #define BITCOIN_SRC_VBK_RPC_REGISTER_HPP
 
+#include <uint256.h>
+
+#include <vector>
+
+class CBlockIndex;
 class CRPCTable;
 
+namespace Consensus {
+struct Params;
+}
+
 namespace VeriBlock {
 
 void RegisterPOPMiningRPCCommands(CRPCTable& t);
 
+//! getpopdata caches results until UpdatedBlockTip announces a new tip. Starts at the active tip, so the block chain has to be loaded.
+void RegisterPopDataCache();
+void UnregisterPopDataCache();
+
+/**
+ * Find payload with id pid in block_index, if given. Otherwise look in PoP
+ * mempool, then in blocks which contain it, which are added to
+ * containingBlocks. Throws JSONRPCError if a block can not be read.
+ * Instantiated for ATV, VTB and VbkBlock.
+ */
+template <typename T>
+bool GetPayload(const typename T::id_t& pid, T& out, const Consensus::Params& consensusParams, const CBlockIndex* const block_index, std::vector<uint256>& containingBlocks);
+
 } // namespace VeriBlock
 
 
@@ -4,8 +4,12 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <boost/test/unit_test.hpp>
+#include <boost/thread/thread.hpp>
 #include <chainparams.h>
+#include <clientversion.h>
+#include <consensus/consensus.h>
 #include <consensus/validation.h>
+#include <miner.h>
 #include <test/util/setup_common.h>
 #include <validation.h>
 #include <vbk/pop_service.hpp>
@@ -188,6 +192,50 @@ BOOST_FIXTURE_TEST_CASE(PopData_payloads_stateless_invalid, E2eFixture)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(PopData_parallel_stateless_validation_reports_first_failure, E2eFixture)
+{
+    altintegration::PopData popData;
+    for (size_t i = 0; i < 10; ++i) {
+        popData.vtbs.push_back(endorseVbkTip());
+    }
+
+    boost::thread_group threadGroup;
+    for (int i = 0; i < 3; ++i) {
+        threadGroup.create_thread([i]() { return VeriBlock::ThreadPopCheck(i); });
+    }
+    VeriBlock::g_parallel_pop_checks = true;
+
+    altintegration::ValidationState state;
+    BOOST_CHECK(VeriBlock::popdataStatelessValidation(popData, state));
+
+    // corrupt two vtbs, the one which goes first must be reported
+    for (size_t i : {3, 7}) {
+        popData.vtbs[i].checked = false;
+        popData.vtbs[i].transaction.signature = {1, 2, 3};
+    }
+    altintegration::ValidationState sequentialState;
+    {
+        auto vtbs = popData.vtbs;
+        vtbs.erase(vtbs.begin() + 4, vtbs.end());
+        altintegration::PopData prefix;
+        prefix.vtbs = vtbs;
+        BOOST_CHECK(!VeriBlock::popdataStatelessValidation(prefix, sequentialState));
+    }
+
+    for (int run = 0; run < 10; ++run) {
+        for (auto& vtb : popData.vtbs) {
+            vtb.checked = false;
+        }
+        altintegration::ValidationState parallelState;
+        BOOST_CHECK(!VeriBlock::popdataStatelessValidation(popData, parallelState));
+        BOOST_CHECK_EQUAL(parallelState.toString(), sequentialState.toString());
+    }
+
+    VeriBlock::g_parallel_pop_checks = false;
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+}
+
 BOOST_FIXTURE_TEST_CASE(PopData_oversized_test, E2eFixture)
 {
     altintegration::PopData popData;
@@ -215,4 +263,51 @@ BOOST_FIXTURE_TEST_CASE(PopData_oversized_test, E2eFixture)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(selectPopData_fits_size_limit, E2eFixture)
+{
+    for (int i = 0; i < 10; ++i) {
+        pop->mempool->submit(endorseVbkTip(), state);
+    }
+    BOOST_CHECK(state.IsValid());
+
+    LOCK(cs_main);
+    const CBlockIndex& tip = *ChainActive().Tip();
+    const auto all = VeriBlock::selectPopData(tip, MAX_BLOCK_SERIALIZED_SIZE);
+    BOOST_CHECK_EQUAL(all.vtbs.size(), 10u);
+
+    const size_t half = ::GetSerializeSize(all, CLIENT_VERSION) / 2;
+    const auto selected = VeriBlock::selectPopData(tip, half);
+    BOOST_CHECK(!selected.vtbs.empty());
+    BOOST_CHECK(selected.vtbs.size() < all.vtbs.size());
+    BOOST_CHECK(::GetSerializeSize(selected, CLIENT_VERSION) <= half);
+
+    // new payloads are picked up without a new tip
+    const uint32_t updated = VeriBlock::getPopMempoolUpdated();
+    pop->mempool->submit(endorseVbkTip(), state);
+    BOOST_CHECK(VeriBlock::getPopMempoolUpdated() != updated);
+    BOOST_CHECK_EQUAL(VeriBlock::selectPopData(tip, MAX_BLOCK_SERIALIZED_SIZE).vtbs.size(), 11u);
+}
+
+BOOST_FIXTURE_TEST_CASE(template_is_not_added_into_alt_tree, E2eFixture)
+{
+    pop->mempool->submit(endorseVbkTip(), state);
+    pop->mempool->submit(endorseAltBlock(ChainActive().Tip()->GetBlockHash(), {}), state);
+    BOOST_CHECK(state.IsValid());
+
+    // CreateNewBlock runs TestBlockValidity
+    auto pblocktemplate = BlockAssembler(Params()).CreateNewBlock(cbKey);
+    BOOST_REQUIRE(pblocktemplate);
+    const CBlock& block = pblocktemplate->block;
+    BOOST_CHECK_EQUAL(block.popData.vtbs.size(), 1u);
+    BOOST_CHECK_EQUAL(block.popData.atvs.size(), 1u);
+
+    LOCK(cs_main);
+    BOOST_CHECK(pop->altTree->getBlockIndex(block.GetHash().asVector()) == nullptr);
+
+    // the same template is checked again from cache
+    BlockValidationState blockState;
+    BOOST_CHECK(TestBlockValidity(blockState, Params(), block, ChainActive().Tip(), false, false));
+    BOOST_CHECK(pop->altTree->getBlockIndex(block.GetHash().asVector()) == nullptr);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -7,6 +7,7 @@
 
 #include <chain.h>
 #include <validation.h>
+#include <vbk/pop_service.hpp>
 #include <vbk/test/util/e2e_fixture.hpp>
 #include <vbk/util.hpp>
 #include <veriblock/alt-util.hpp>
@@ -60,4 +61,41 @@ BOOST_FIXTURE_TEST_CASE(ValidBlockIsAccepted, E2eFixture)
     BOOST_CHECK(block.popData.atvs.size() == 0);
 }
 
+BOOST_FIXTURE_TEST_CASE(PayloadsAreResubmittedAfterReorg, E2eFixture)
+{
+    auto* endorsed = ChainActive().Tip();
+    CBlock block1 = endorseAltBlockAndMine(endorsed->GetBlockHash(), 1);
+    CBlock block2 = endorseAltBlockAndMine(endorsed->GetBlockHash(), 1);
+    BOOST_REQUIRE(ChainActive().Tip()->GetBlockHash() == block2.GetHash());
+    BOOST_CHECK_EQUAL(block1.popData.atvs.size(), 1u);
+    BOOST_CHECK_EQUAL(block2.popData.atvs.size(), 1u);
+
+    CBlockIndex* index1 = nullptr;
+    {
+        LOCK(cs_main);
+        index1 = LookupBlockIndex(block1.GetHash());
+        BOOST_REQUIRE(index1 != nullptr);
+    }
+
+    // payloads of both disconnected blocks are back in PoP mempool
+    InvalidateTestBlock(index1);
+    BOOST_REQUIRE(ChainActive().Tip() == endorsed);
+    {
+        LOCK(cs_main);
+        auto popData = VeriBlock::getPopData();
+        BOOST_CHECK_EQUAL(popData.atvs.size(), 2u);
+        BOOST_CHECK_EQUAL(popData.vtbs.size(), 2u);
+    }
+
+    // and are removed again, once the blocks are connected
+    ReconsiderTestBlock(index1);
+    BOOST_REQUIRE(ChainActive().Tip()->GetBlockHash() == block2.GetHash());
+    {
+        LOCK(cs_main);
+        auto popData = VeriBlock::getPopData();
+        BOOST_CHECK(popData.atvs.empty());
+        BOOST_CHECK(popData.vtbs.empty());
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
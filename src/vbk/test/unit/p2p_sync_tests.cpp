@@ -0,0 +1,125 @@
+// Copyright (c) 2019-2020 Xenios SEZC
+// https://www.veriblock.org
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <boost/test/unit_test.hpp>
+
+#include <crypto/common.h>
+#include <net.h>
+#include <streams.h>
+#include <test/util/setup_common.h>
+#include <vbk/p2p_sync.hpp>
+
+using VeriBlock::p2p::PopP2PStateCache;
+
+BOOST_FIXTURE_TEST_SUITE(p2p_sync_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(PopP2PStateCache_evicts_least_recently_used)
+{
+    PopP2PStateCache<altintegration::ATV::id_t> cache(2);
+    altintegration::ATV::id_t a(std::vector<uint8_t>(32, 1));
+    altintegration::ATV::id_t b(std::vector<uint8_t>(32, 2));
+    altintegration::ATV::id_t c(std::vector<uint8_t>(32, 3));
+
+    cache.get(a).known_pop_data = 1;
+    cache.get(b).known_pop_data = 2;
+    // touch a, so b becomes the oldest entry
+    BOOST_CHECK_EQUAL(cache.get(a).known_pop_data, 1u);
+    cache.get(c).known_pop_data = 3;
+
+    BOOST_CHECK_EQUAL(cache.size(), 2u);
+    BOOST_CHECK_EQUAL(cache.get(a).known_pop_data, 1u);
+    BOOST_CHECK_EQUAL(cache.get(c).known_pop_data, 3u);
+    // b has been evicted and starts over
+    BOOST_CHECK_EQUAL(cache.get(b).known_pop_data, 0u);
+    BOOST_CHECK_EQUAL(cache.size(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(PopDataNodeState_is_bounded)
+{
+    VeriBlock::p2p::PopDataNodeState state;
+    const size_t initial = state.DynamicMemoryUsage();
+
+    for (uint32_t i = 0; i < 5 * VeriBlock::p2p::MAX_POP_RELAY_COUNTERS; ++i) {
+        std::vector<uint8_t> bytes(32, 0);
+        WriteLE32(bytes.data(), i);
+        state.vtb_state.get(bytes).requested_pop_data++;
+        state.filterKnown.insert(bytes);
+    }
+
+    BOOST_CHECK_EQUAL(state.vtb_state.size(), VeriBlock::p2p::MAX_POP_RELAY_COUNTERS);
+    BOOST_CHECK(state.DynamicMemoryUsage() > initial);
+
+    // mined payloads are dropped from the counters
+    std::vector<uint8_t> last(32, 0);
+    WriteLE32(last.data(), 5 * VeriBlock::p2p::MAX_POP_RELAY_COUNTERS - 1);
+    state.vtb_state.erase(last);
+    BOOST_CHECK_EQUAL(state.vtb_state.size(), VeriBlock::p2p::MAX_POP_RELAY_COUNTERS - 1);
+}
+
+BOOST_AUTO_TEST_CASE(accepted_payloads_are_queued_for_known_peers)
+{
+    const NodeId id = 42;
+    altintegration::VbkBlock block;
+
+    {
+        LOCK(VeriBlock::cs_popmempool);
+        VeriBlock::p2p::getPopDataNodeState(id);
+    }
+    VeriBlock::p2p::offerPopDataToAllNodes(block);
+    VeriBlock::p2p::offerPopDataToAllNodes(block);
+
+    {
+        LOCK(VeriBlock::cs_popmempool);
+        auto& to_send = VeriBlock::p2p::getPopDataNodeState(id).vbk_blocks_to_send;
+        BOOST_CHECK_EQUAL(to_send.size(), 1u);
+        BOOST_CHECK(to_send.count(block.getId()));
+    }
+
+    altintegration::PopData popData;
+    popData.context.push_back(block);
+    {
+        LOCK(VeriBlock::cs_popmempool);
+        VeriBlock::p2p::erasePopDataFromNodeStates(popData);
+        BOOST_CHECK(VeriBlock::p2p::getPopDataNodeState(id).vbk_blocks_to_send.empty());
+    }
+    VeriBlock::p2p::erasePopDataNodeState(id);
+}
+
+static int sendGetAtvs(CNode& node, CConnman& connman, uint32_t first, uint32_t count)
+{
+    std::vector<std::vector<uint8_t>> ids;
+    for (uint32_t i = first; i < first + count; ++i) {
+        std::vector<uint8_t> bytes(32, 0);
+        WriteLE32(bytes.data(), i);
+        ids.push_back(bytes);
+    }
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << ids;
+    return VeriBlock::p2p::processPopData(&node, VeriBlock::p2p::get_prefix + altintegration::ATV::name(), stream, &connman);
+}
+
+BOOST_FIXTURE_TEST_CASE(flooding_message_can_not_evict_counters, TestingSetup)
+{
+    CConnman connman(0x1337, 0x1337);
+    CAddress addr(CService(), NODE_NONE);
+    CNode node(0, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, CAddress(), "", true);
+
+    // a message may add half of the counters
+    BOOST_CHECK(sendGetAtvs(node, connman, 1, VeriBlock::p2p::MAX_POP_RELAY_NEW_COUNTERS));
+
+    // the same payload is requested up to the limit
+    for (uint32_t i = 0; i <= VeriBlock::p2p::MAX_POP_MESSAGE_SENDING_COUNT; ++i) {
+        BOOST_CHECK(sendGetAtvs(node, connman, 0, 1));
+    }
+
+    // a message which would flush the counters is refused
+    BOOST_CHECK(!sendGetAtvs(node, connman, 1 + VeriBlock::p2p::MAX_POP_RELAY_NEW_COUNTERS, VeriBlock::p2p::MAX_POP_DATA_SENDING_AMOUNT));
+    // and the counter of the spammed payload is still there
+    BOOST_CHECK(!sendGetAtvs(node, connman, 0, 1));
+
+    VeriBlock::p2p::erasePopDataNodeState(node.GetId());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,193 @@
+// Copyright (c) 2019-2020 Xenios SEZC
+// https://www.veriblock.org
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <boost/test/unit_test.hpp>
+
+#include <blockencodings.h>
+#include <net.h>
+#include <net_processing.h>
+#include <netmessagemaker.h>
+#include <protocol.h>
+#include <streams.h>
+#include <txmempool.h>
+#include <util/memory.h>
+#include <vbk/test/util/e2e_fixture.hpp>
+
+BOOST_AUTO_TEST_SUITE(pop_compact_block_tests)
+
+namespace {
+
+struct PopConnmanTest : public CConnman {
+    using CConnman::CConnman;
+    void AddNode(CNode& node)
+    {
+        LOCK(cs_vNodes);
+        vNodes.push_back(&node);
+    }
+    void ClearNodes()
+    {
+        LOCK(cs_vNodes);
+        vNodes.clear();
+    }
+};
+
+template <typename... Args>
+void ReceiveMessage(PeerLogicValidation& peerLogic, CNode& node, const std::string& command, Args&&... args)
+{
+    CSerializedNetMsg serialized = CNetMsgMaker(PROTOCOL_VERSION).Make(command, std::forward<Args>(args)...);
+    CNetMessage msg(CDataStream(serialized.data, SER_NETWORK, PROTOCOL_VERSION));
+    msg.m_command = command;
+    msg.m_message_size = msg.m_recv.size();
+    msg.m_valid_netmagic = msg.m_valid_header = msg.m_valid_checksum = true;
+    {
+        LOCK(node.cs_vProcessMsg);
+        node.vProcessMsg.push_back(std::move(msg));
+    }
+    std::atomic<bool> interrupt{false};
+    peerLogic.ProcessMessages(&node, interrupt);
+}
+
+//! Payloads of messages queued to node with the given command
+std::vector<std::vector<unsigned char>> SentMessages(CNode& node, const std::string& command)
+{
+    std::vector<std::vector<unsigned char>> ret;
+    LOCK(node.cs_vSend);
+    for (auto it = node.vSendMsg.begin(); it != node.vSendMsg.end(); ++it) {
+        CMessageHeader hdr(Params().MessageStart());
+        CDataStream(*it, SER_NETWORK, INIT_PROTO_VERSION) >> hdr;
+        std::vector<unsigned char> data;
+        if (hdr.nMessageSize > 0) {
+            data = *++it;
+        }
+        if (hdr.GetCommand() == command) {
+            ret.push_back(std::move(data));
+        }
+    }
+    return ret;
+}
+
+} // namespace
+
+static CBlockHeaderAndShortTxIDs RoundTrip(const CBlockHeaderAndShortTxIDs& cmpctblock, int version)
+{
+    CDataStream stream(SER_NETWORK, version);
+    stream << cmpctblock;
+    CBlockHeaderAndShortTxIDs ret;
+    stream >> ret;
+    return ret;
+}
+
+BOOST_FIXTURE_TEST_CASE(compact_block_carries_pop_short_ids, E2eFixture)
+{
+    CBlock block = endorseAltBlockAndMine(ChainActive().Tip()->GetBlockHash(), 2);
+    BOOST_REQUIRE(!block.popData.atvs.empty());
+
+    CBlockHeaderAndShortTxIDs cmpctblock(block, true);
+    const size_t full_size = GetSerializeSize(cmpctblock, POP_SHORT_IDS_VERSION - 1);
+    const size_t short_size = GetSerializeSize(cmpctblock, POP_SHORT_IDS_VERSION);
+    BOOST_CHECK(short_size < full_size);
+
+    // payloads were removed from PoP mempool when the block was connected,
+    // so all of them have to be requested
+    CBlockHeaderAndShortTxIDs received = RoundTrip(cmpctblock, PROTOCOL_VERSION);
+    BOOST_CHECK(received.popData.empty());
+
+    PartiallyDownloadedBlock partialBlock(&mempool);
+    BOOST_CHECK(partialBlock.InitData(received, {}) == READ_STATUS_OK);
+
+    BlockTransactionsRequest req;
+    partialBlock.GetMissingPopData(req);
+    BOOST_CHECK_EQUAL(req.vbk_indexes.size(), block.popData.context.size());
+    BOOST_CHECK_EQUAL(req.vtb_indexes.size(), block.popData.vtbs.size());
+    BOOST_CHECK_EQUAL(req.atv_indexes.size(), block.popData.atvs.size());
+
+    // incomplete responses are rejected
+    {
+        PartiallyDownloadedBlock incomplete(&mempool);
+        BOOST_CHECK(incomplete.InitData(received, {}) == READ_STATUS_OK);
+        altintegration::PopData missing = block.popData;
+        missing.atvs.pop_back();
+        CBlock out;
+        BOOST_CHECK(incomplete.FillBlock(out, {}, missing) == READ_STATUS_INVALID);
+    }
+
+    CBlock reconstructed;
+    BOOST_CHECK(partialBlock.FillBlock(reconstructed, {}, block.popData) == READ_STATUS_OK);
+    BOOST_CHECK(reconstructed.GetHash() == block.GetHash());
+    BOOST_CHECK(reconstructed.popData.toVbkEncoding() == block.popData.toVbkEncoding());
+}
+
+BOOST_FIXTURE_TEST_CASE(compact_block_from_old_peer_has_full_pop_data, E2eFixture)
+{
+    CBlock block = endorseAltBlockAndMine(ChainActive().Tip()->GetBlockHash(), 1);
+
+    CBlockHeaderAndShortTxIDs received = RoundTrip(CBlockHeaderAndShortTxIDs(block, true), POP_SHORT_IDS_VERSION - 1);
+    PartiallyDownloadedBlock partialBlock(&mempool);
+    BOOST_CHECK(partialBlock.InitData(received, {}) == READ_STATUS_OK);
+
+    BlockTransactionsRequest req;
+    partialBlock.GetMissingPopData(req);
+    BOOST_CHECK(!req.HasPopIndexes());
+
+    CBlock reconstructed;
+    BOOST_CHECK(partialBlock.FillBlock(reconstructed, {}) == READ_STATUS_OK);
+    BOOST_CHECK(reconstructed.popData.toVbkEncoding() == block.popData.toVbkEncoding());
+}
+
+// high bandwidth peers are sent compact blocks as soon as they pass PoW checks
+BOOST_FIXTURE_TEST_CASE(new_block_announcement_matches_peer_version, E2eFixture)
+{
+    CBlock block = endorseAltBlockAndMine(ChainActive().Tip()->GetBlockHash(), 1);
+    const CBlockIndex* pindex = LookupBlockIndex(block.GetHash());
+    BOOST_REQUIRE(pindex != nullptr);
+
+    auto connman = MakeUnique<PopConnmanTest>(0x1337, 0x1337);
+    auto peerLogic = MakeUnique<PeerLogicValidation>(connman.get(), nullptr, scheduler);
+
+    const std::vector<int> versions{POP_SHORT_IDS_VERSION - 1, PROTOCOL_VERSION};
+    std::vector<std::unique_ptr<CNode>> nodes;
+    for (int version : versions) {
+        CAddress addr(CService(), NODE_NONE);
+        nodes.emplace_back(new CNode(nodes.size(), ServiceFlags(NODE_NETWORK | NODE_WITNESS), 0, INVALID_SOCKET, addr, 0, 0, CAddress(), "", /*fInboundIn=*/false));
+        CNode& node = *nodes.back();
+        peerLogic->InitializeNode(&node);
+        node.nVersion = version;
+        node.SetSendVersion(version);
+        node.SetRecvVersion(version);
+        node.fSuccessfullyConnected = true;
+        connman->AddNode(node);
+
+        // peer wants witness compact blocks and has the parent of the new block
+        ReceiveMessage(*peerLogic, node, NetMsgType::SENDCMPCT, true, uint64_t(2));
+        ReceiveMessage(*peerLogic, node, NetMsgType::INV, std::vector<CInv>{CInv(MSG_BLOCK, pindex->pprev->GetBlockHash())});
+        BOOST_REQUIRE(!node.fDisconnect);
+    }
+
+    peerLogic->NewPoWValidBlock(pindex, std::make_shared<const CBlock>(block));
+
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        auto sent = SentMessages(*nodes[i], NetMsgType::CMPCTBLOCK);
+        BOOST_REQUIRE_EQUAL(sent.size(), 1u);
+
+        CDataStream stream(sent[0], SER_NETWORK, versions[i]);
+        CBlockHeaderAndShortTxIDs received;
+        stream >> received;
+        BOOST_CHECK(stream.empty());
+        BOOST_CHECK(received.header.GetHash() == block.GetHash());
+        if (versions[i] < POP_SHORT_IDS_VERSION) {
+            BOOST_CHECK(received.popData.toVbkEncoding() == block.popData.toVbkEncoding());
+        } else {
+            BOOST_CHECK(received.popData.empty());
+        }
+    }
+
+    bool dummy;
+    for (auto& node : nodes) {
+        peerLogic->FinalizeNode(node->GetId(), dummy);
+    }
+    connman->ClearNodes();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
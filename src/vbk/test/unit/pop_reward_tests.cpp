@@ -91,6 +91,28 @@ BOOST_FIXTURE_TEST_CASE(addPopPayoutsIntoCoinbaseTx_test, PopRewardsTestFixture)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(getPopRewards_is_cached_until_pop_state_changes, PopRewardsTestFixture)
+{
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    std::vector<uint8_t> payoutInfo{scriptPubKey.begin(), scriptPubKey.end()};
+    auto* tip = ChainActive().Tip();
+    endorseAltBlockAndMine(tip->GetAncestor(100)->GetBlockHash(), tip->GetBlockHash(), payoutInfo, 0);
+
+    int rewardInterval = (int)VeriBlock::GetPop().config->alt->getEndorsementSettlementInterval();
+    for (int i = 0; i < (rewardInterval - 2); i++) {
+        CreateAndProcessBlock({}, scriptPubKey);
+    }
+
+    LOCK(cs_main);
+    const auto& params = Params().GetConsensus();
+    auto cached = VeriBlock::getPopRewards(*ChainActive().Tip(), params);
+    BOOST_CHECK(!cached.empty());
+    BOOST_CHECK(VeriBlock::getPopRewards(*ChainActive().Tip(), params) == cached);
+
+    VeriBlock::onPopStateChanged();
+    BOOST_CHECK(VeriBlock::getPopRewards(*ChainActive().Tip(), params) == cached);
+}
+
 //BOOST_FIXTURE_TEST_CASE(addPopPayoutsIntoCoinbaseTx_test, PopRewardsTestFixture)
 //{
 //    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
@@ -0,0 +1,385 @@
+// Copyright (c) 2019-2020 Xenios SEZC
+// https://www.veriblock.org
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <boost/test/unit_test.hpp>
+
+#include <bootstraps.h>
+#include <clientversion.h>
+#include <fs.h>
+#include <streams.h>
+#include <txdb.h>
+#include <validation.h>
+#include <vbk/adaptors/batch_adapter.hpp>
+#include <vbk/adaptors/repository.hpp>
+#include <vbk/pop_db.hpp>
+#include <vbk/pop_service.hpp>
+#include <vbk/test/util/e2e_fixture.hpp>
+
+#include <map>
+#include <utility>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(pop_storage_tests)
+
+//! hashes of all blocks of a tree with their heights, and the hash of its tip
+using TreeSnapshot = std::pair<std::map<std::vector<uint8_t>, int32_t>, std::vector<uint8_t>>;
+
+template <typename Tree>
+static TreeSnapshot GetTreeSnapshot(const Tree& tree)
+{
+    TreeSnapshot ret;
+    for (const auto& it : tree.getBlocks()) {
+        auto hash = it.second->getHash();
+        ret.first.emplace(std::vector<uint8_t>(hash.begin(), hash.end()), it.second->getHeight());
+    }
+    auto tip = tree.getBestChain().tip()->getHash();
+    ret.second = std::vector<uint8_t>(tip.begin(), tip.end());
+    return ret;
+}
+
+static std::vector<TreeSnapshot> GetTreeSnapshots()
+{
+    auto& altTree = *VeriBlock::GetPop().altTree;
+    return {GetTreeSnapshot(altTree.btc()), GetTreeSnapshot(altTree.vbk()), GetTreeSnapshot(altTree)};
+}
+
+static void CheckTreesEqual(const std::vector<TreeSnapshot>& expected, const std::vector<TreeSnapshot>& actual)
+{
+    BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        BOOST_CHECK_EQUAL(expected[i].first.size(), actual[i].first.size());
+        BOOST_CHECK(expected[i].first == actual[i].first);
+        BOOST_CHECK(expected[i].second == actual[i].second);
+    }
+}
+
+//! moves blocks of tree from height ordered keys to keys written by previous versions
+template <typename Tree>
+static void WriteLegacyBlocks(CDBBatch& batch, const Tree& tree, char type, char legacytype)
+{
+    using hash_t = typename Tree::hash_t;
+    for (const auto& it : tree.getBlocks()) {
+        const auto& index = *it.second;
+        batch.Erase(VeriBlock::BlockIndexKey<hash_t>(type, index.getHeight(), index.getHash()));
+        batch.Write(std::make_pair(legacytype, index.getHash()), index);
+    }
+}
+
+template <typename Tree>
+static void CheckMigrated(CDBWrapper& db, const Tree& tree, char type, char legacytype)
+{
+    using hash_t = typename Tree::hash_t;
+    for (const auto& it : tree.getBlocks()) {
+        const auto& index = *it.second;
+        BOOST_CHECK(!db.Exists(std::make_pair(legacytype, index.getHash())));
+        BOOST_CHECK(db.Exists(VeriBlock::BlockIndexKey<hash_t>(type, index.getHeight(), index.getHash())));
+    }
+}
+
+//! writes all changed PoP blocks and tips, as FlushStateToDisk does
+static void FlushTrees()
+{
+    AssertLockHeld(cs_main);
+    CDBBatch batch(*pblocktree);
+    VeriBlock::saveTrees(batch);
+    BOOST_REQUIRE(pblocktree->WriteBatch(batch, true));
+    VeriBlock::onTreesSaved();
+}
+
+//! creates fresh trees and loads them from block tree db, as on startup
+static void ReloadTrees()
+{
+    AssertLockHeld(cs_main);
+    VeriBlock::SetPop(*pblocktree);
+    BOOST_REQUIRE(VeriBlock::loadTrees(*pblocktree));
+}
+
+BOOST_AUTO_TEST_CASE(DirtyTracker_detects_changes)
+{
+    VeriBlock::DirtyTracker tracker;
+    std::vector<uint8_t> hash{1, 2, 3};
+
+    BOOST_CHECK(tracker.setWritten(VeriBlock::DB_ALT_BLOCK, hash, {1}));
+    BOOST_CHECK(!tracker.setWritten(VeriBlock::DB_ALT_BLOCK, hash, {1}));
+    // same hash in other tree is a different entry
+    BOOST_CHECK(tracker.setWritten(VeriBlock::DB_VBK_BLOCK, hash, {1}));
+    BOOST_CHECK(tracker.setWritten(VeriBlock::DB_ALT_BLOCK, hash, {2}));
+    BOOST_CHECK(!tracker.setWritten(VeriBlock::DB_ALT_BLOCK, hash, {2}));
+    BOOST_CHECK_EQUAL(tracker.size(), 2u);
+
+    tracker.clear();
+    BOOST_CHECK(tracker.setWritten(VeriBlock::DB_ALT_BLOCK, hash, {2}));
+}
+
+BOOST_AUTO_TEST_CASE(BlockIndexKey_is_ordered_by_height)
+{
+    using key_t = VeriBlock::BlockIndexKey<std::vector<uint8_t>>;
+    auto serialize = [](const key_t& key) {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << key;
+        return std::vector<uint8_t>(ss.begin(), ss.end());
+    };
+
+    auto low = serialize(key_t(VeriBlock::DB_ALT_BLOCK, 255, {0xff}));
+    auto high = serialize(key_t(VeriBlock::DB_ALT_BLOCK, 256, {0x00}));
+    BOOST_CHECK(low < high);
+
+    CDataStream ss(high, SER_DISK, CLIENT_VERSION);
+    key_t key;
+    ss >> key;
+    BOOST_CHECK_EQUAL(key.prefix, VeriBlock::DB_ALT_BLOCK);
+    BOOST_CHECK_EQUAL(key.height, 256u);
+    BOOST_CHECK(key.hash == std::vector<uint8_t>{0x00});
+}
+
+BOOST_FIXTURE_TEST_CASE(Repository_write_behind, BasicTestingSetup)
+{
+    CDBWrapper db(GetDataDir() / "pop_repository", 1 << 20, true, false, false);
+    VeriBlock::Repository repo(db, true);
+    std::vector<uint8_t> key{1, 2, 3};
+    std::vector<uint8_t> value{4, 5, 6};
+    std::vector<uint8_t> read;
+
+    // writes are visible before they reach the database
+    BOOST_CHECK(repo.put(key, value));
+    BOOST_CHECK(repo.get(key, &read));
+    BOOST_CHECK(read == value);
+    BOOST_CHECK(!db.Exists(key));
+
+    CDBBatch batch(db);
+    repo.flush(batch);
+    BOOST_CHECK(db.WriteBatch(batch, true));
+    repo.flushed();
+    BOOST_CHECK(db.Exists(key));
+
+    BOOST_CHECK(repo.remove(key));
+    BOOST_CHECK(!repo.get(key, nullptr));
+    BOOST_CHECK(db.Exists(key));
+
+    // queued writes are committed before a cursor is created, so it sees them
+    std::vector<uint8_t> other{7, 8, 9};
+    BOOST_CHECK(repo.put(other, value));
+    auto cursor = repo.newCursor();
+    BOOST_CHECK(!db.Exists(key));
+    cursor->seek(key);
+    BOOST_REQUIRE(cursor->isValid());
+    BOOST_CHECK(cursor->key() == other);
+    BOOST_CHECK(cursor->value() == value);
+}
+
+namespace {
+//! Repository whose group commits fail while fail is set
+struct FailingRepository : public VeriBlock::Repository {
+    using VeriBlock::Repository::Repository;
+    bool fail{false};
+
+protected:
+    bool writeBatch(CDBBatch& batch) const override
+    {
+        return !fail && VeriBlock::Repository::writeBatch(batch);
+    }
+};
+} // namespace
+
+BOOST_FIXTURE_TEST_CASE(Repository_write_behind_keeps_writes_on_failure, BasicTestingSetup)
+{
+    CDBWrapper db(GetDataDir() / "pop_repository_failure", 1 << 20, true, false, false);
+    FailingRepository repo(db, true);
+    std::vector<uint8_t> key{1, 2, 3};
+    std::vector<uint8_t> value{4, 5, 6};
+    std::vector<uint8_t> read;
+    BOOST_CHECK(repo.put(key, value));
+
+    // failed group commit is reported and the write stays queued
+    repo.fail = true;
+    BOOST_CHECK_THROW(repo.newBatch(), dbwrapper_error);
+    BOOST_CHECK_THROW(repo.newCursor(), dbwrapper_error);
+    BOOST_CHECK(!db.Exists(key));
+    BOOST_CHECK(repo.get(key, &read));
+    BOOST_CHECK(read == value);
+
+    // the block index batch was not written, so the write stays queued
+    {
+        CDBBatch batch(db);
+        repo.flush(batch);
+    }
+    BOOST_CHECK(repo.get(key, &read));
+    BOOST_CHECK(read == value);
+
+    // a write made after flush() is not dropped by flushed()
+    std::vector<uint8_t> other{7, 8, 9};
+    CDBBatch batch(db);
+    repo.flush(batch);
+    BOOST_CHECK(repo.put(key, other));
+    BOOST_CHECK(db.WriteBatch(batch, true));
+    repo.flushed();
+    BOOST_CHECK(db.Read(key, read));
+    BOOST_CHECK(read == value);
+    BOOST_CHECK(repo.get(key, &read));
+    BOOST_CHECK(read == other);
+
+    // the next successful commit writes it
+    repo.fail = false;
+    BOOST_CHECK(repo.newBatch() != nullptr);
+    BOOST_CHECK(db.Read(key, read));
+    BOOST_CHECK(read == other);
+}
+
+BOOST_FIXTURE_TEST_CASE(Cursor_iterates_backwards, BasicTestingSetup)
+{
+    CDBWrapper db(GetDataDir() / "pop_cursor", 1 << 20, true, false, false);
+    VeriBlock::Repository repo(db);
+    for (uint8_t i = 0; i < 10; ++i) {
+        BOOST_CHECK(repo.put({i}, std::vector<uint8_t>(300, i)));
+    }
+
+    auto cursor = repo.newCursor();
+    uint8_t expected = 10;
+    for (cursor->seekToLast(); cursor->isValid(); cursor->prev()) {
+        --expected;
+        BOOST_CHECK(cursor->key() == std::vector<uint8_t>{expected});
+
+        auto key = static_cast<VeriBlock::Cursor&>(*cursor).keyView();
+        BOOST_REQUIRE_EQUAL(key.size(), 1);
+        BOOST_CHECK_EQUAL(key[0], expected);
+        Span<const uint8_t> value;
+        BOOST_REQUIRE(static_cast<VeriBlock::Cursor&>(*cursor).valueView(value));
+        BOOST_CHECK(std::vector<uint8_t>(value.begin(), value.end()) == cursor->value());
+        BOOST_CHECK_EQUAL(value.size(), 300);
+    }
+    BOOST_CHECK_EQUAL(expected, 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(PopDB_migrates_pop_data, BasicTestingSetup)
+{
+    using VeriBlock::BatchAdapter;
+    CDBWrapper blocktree(GetDataDir() / "blocktree", 1 << 20, true, false, false);
+    VeriBlock::PopDB popdb(1 << 20, true);
+    const std::vector<uint8_t> hash{1, 2, 3};
+    const auto block = std::make_pair(VeriBlock::DB_ALT_BLOCK_LEGACY, hash);
+    const auto other = std::make_pair('b', hash);
+
+    // nothing to migrate
+    BOOST_CHECK(popdb.MigrateFrom(blocktree));
+    BOOST_CHECK(popdb.IsEmpty());
+
+    BOOST_CHECK(blocktree.Write(BatchAdapter::btctip(), hash));
+    BOOST_CHECK(blocktree.Write(BatchAdapter::vbktip(), hash));
+    BOOST_CHECK(blocktree.Write(BatchAdapter::alttip(), hash));
+    BOOST_CHECK(blocktree.Write(block, std::vector<uint8_t>(300, 1)));
+    BOOST_CHECK(blocktree.Write(other, hash));
+
+    BOOST_CHECK(popdb.MigrateFrom(blocktree));
+    BOOST_CHECK(VeriBlock::hasPopData(popdb));
+    BOOST_CHECK(!VeriBlock::hasPopData(blocktree));
+    std::vector<uint8_t> value;
+    BOOST_CHECK(popdb.Read(block, value));
+    BOOST_CHECK(value == std::vector<uint8_t>(300, 1));
+    BOOST_CHECK(!blocktree.Exists(block));
+    // entries of the block index stay
+    BOOST_CHECK(blocktree.Exists(other));
+    BOOST_CHECK(!popdb.Exists(other));
+}
+
+BOOST_FIXTURE_TEST_CASE(saveTrees_writes_only_changed_blocks, E2eFixture)
+{
+    const size_t emptySize = CDBBatch(*pblocktree).SizeEstimate();
+
+    {
+        LOCK(cs_main);
+        // flush everything which is not yet written
+        CDBBatch initial(*pblocktree);
+        VeriBlock::saveTrees(initial);
+        BOOST_CHECK(pblocktree->WriteBatch(initial, true));
+
+        // nothing changed since last flush
+        CDBBatch unchanged(*pblocktree);
+        VeriBlock::saveTrees(unchanged);
+        BOOST_CHECK_EQUAL(unchanged.SizeEstimate(), emptySize);
+    }
+
+    // new block updates ALT tree
+    CreateAndProcessBlock({}, cbKey);
+
+    LOCK(cs_main);
+    CDBBatch changed(*pblocktree);
+    VeriBlock::saveTrees(changed);
+    BOOST_CHECK_GT(changed.SizeEstimate(), emptySize);
+}
+
+BOOST_FIXTURE_TEST_CASE(saveTrees_loadTrees_round_trip, E2eFixture)
+{
+    // VTBs add blocks to BTC and VBK trees too
+    endorseAltBlockAndMine(ChainActive().Tip()->GetBlockHash(), 1);
+
+    LOCK(cs_main);
+    const auto expected = GetTreeSnapshots();
+    BOOST_REQUIRE_GT(expected[0].first.size(), 1u);
+    BOOST_REQUIRE_GT(expected[1].first.size(), 1u);
+    BOOST_REQUIRE_GT(expected[2].first.size(), 100u);
+
+    FlushTrees();
+    ReloadTrees();
+    CheckTreesEqual(expected, GetTreeSnapshots());
+}
+
+BOOST_FIXTURE_TEST_CASE(loadTrees_migrates_legacy_blocks, E2eFixture)
+{
+    endorseAltBlockAndMine(ChainActive().Tip()->GetBlockHash(), 1);
+
+    LOCK(cs_main);
+    const auto expected = GetTreeSnapshots();
+    FlushTrees();
+    {
+        auto& altTree = *VeriBlock::GetPop().altTree;
+        CDBBatch batch(*pblocktree);
+        WriteLegacyBlocks(batch, altTree.btc(), VeriBlock::DB_BTC_BLOCK, VeriBlock::DB_BTC_BLOCK_LEGACY);
+        WriteLegacyBlocks(batch, altTree.vbk(), VeriBlock::DB_VBK_BLOCK, VeriBlock::DB_VBK_BLOCK_LEGACY);
+        WriteLegacyBlocks(batch, altTree, VeriBlock::DB_ALT_BLOCK, VeriBlock::DB_ALT_BLOCK_LEGACY);
+        BOOST_REQUIRE(pblocktree->WriteBatch(batch, true));
+    }
+
+    ReloadTrees();
+    CheckTreesEqual(expected, GetTreeSnapshots());
+
+    auto& altTree = *VeriBlock::GetPop().altTree;
+    CheckMigrated(*pblocktree, altTree.btc(), VeriBlock::DB_BTC_BLOCK, VeriBlock::DB_BTC_BLOCK_LEGACY);
+    CheckMigrated(*pblocktree, altTree.vbk(), VeriBlock::DB_VBK_BLOCK, VeriBlock::DB_VBK_BLOCK_LEGACY);
+    CheckMigrated(*pblocktree, altTree, VeriBlock::DB_ALT_BLOCK, VeriBlock::DB_ALT_BLOCK_LEGACY);
+
+    // migrated blocks load again
+    ReloadTrees();
+    CheckTreesEqual(expected, GetTreeSnapshots());
+}
+
+BOOST_FIXTURE_TEST_CASE(pop_bootstrap_file, BasicTestingSetup)
+{
+    BOOST_CHECK_THROW(selectPopConfig("test", "test", true, 0, {}, 0, {}, (GetDataDir() / "missing.dat").string()), std::runtime_error);
+
+    PopBootstrapFile bootstrap;
+    bootstrap.btcStartHeight = testnetBTCstartHeight;
+    bootstrap.btcBlocks.assign(testnetBTCblocks, testnetBTCblocks + testnetBTCblocksSize);
+    bootstrap.vbkStartHeight = testnetVBKstartHeight;
+    bootstrap.vbkBlocks.assign(testnetVBKblocks, testnetVBKblocks + testnetVBKblocksSize);
+
+    const fs::path path = GetDataDir() / "bootstrap.dat";
+    {
+        CAutoFile file(fsbridge::fopen(path, "wb"), SER_DISK, CLIENT_VERSION);
+        file << bootstrap;
+    }
+    BOOST_CHECK_NO_THROW(selectPopConfig("test", "test", true, 0, {}, 0, {}, path.string()));
+
+    // last BTC header is truncated
+    bootstrap.btcBlocks.pop_back();
+    {
+        CAutoFile file(fsbridge::fopen(path, "wb"), SER_DISK, CLIENT_VERSION);
+        file << bootstrap;
+    }
+    BOOST_CHECK_THROW(selectPopConfig("test", "test", true, 0, {}, 0, {}, path.string()), std::exception);
+
+    selectPopConfig("regtest", "regtest", true);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
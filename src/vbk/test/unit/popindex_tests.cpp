@@ -0,0 +1,66 @@
+// Copyright (c) 2019-2020 Xenios SEZC
+// https://www.veriblock.org
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <boost/test/unit_test.hpp>
+
+#include <util/time.h>
+#include <vbk/popindex.hpp>
+#include <vbk/test/util/e2e_fixture.hpp>
+
+BOOST_AUTO_TEST_SUITE(popindex_tests)
+
+BOOST_FIXTURE_TEST_CASE(popindex_finds_payloads_in_blocks, E2eFixture)
+{
+    VeriBlock::PopIndex popindex(1 << 20, true);
+
+    CBlock block = endorseAltBlockAndMine(ChainActive().Tip()->GetBlockHash(), 2);
+    BOOST_REQUIRE(!block.popData.atvs.empty());
+    BOOST_REQUIRE(!block.popData.vtbs.empty());
+
+    popindex.Start();
+
+    // Allow pop index to catch up with the block index.
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!popindex.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        MilliSleep(100);
+    }
+
+    uint256 block_hash;
+    for (const auto& atv : block.popData.atvs) {
+        ATV out;
+        BOOST_CHECK(popindex.FindPayload(atv.getId(), out, block_hash));
+        BOOST_CHECK(out.getId() == atv.getId());
+        // the payload is read on its own, and decodes to the same bytes
+        BOOST_CHECK(out.toVbkEncoding() == atv.toVbkEncoding());
+        BOOST_CHECK(block_hash == block.GetHash());
+    }
+    for (const auto& vtb : block.popData.vtbs) {
+        VTB out;
+        BOOST_CHECK(popindex.FindPayload(vtb.getId(), out, block_hash));
+        BOOST_CHECK(out.getId() == vtb.getId());
+        BOOST_CHECK(out.toVbkEncoding() == vtb.toVbkEncoding());
+    }
+    for (const auto& vbk : block.popData.context) {
+        VbkBlock out;
+        BOOST_CHECK(popindex.FindPayload(vbk.getId(), out, block_hash));
+        BOOST_CHECK(out.getId() == vbk.getId());
+    }
+
+    // payloads of blocks connected later are indexed as well
+    CBlock next = endorseAltBlockAndMine(ChainActive().Tip()->GetBlockHash(), 0);
+    BOOST_CHECK(popindex.BlockUntilSyncedToCurrentChain());
+    ATV out;
+    BOOST_CHECK(popindex.FindPayload(next.popData.atvs.at(0).getId(), out, block_hash));
+    BOOST_CHECK(block_hash == next.GetHash());
+
+    popindex.Stop();
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
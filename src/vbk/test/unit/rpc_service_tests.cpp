@@ -17,6 +17,8 @@
 #include <wallet/wallet.h>
 #include <string>
 #include <vbk/merkle.hpp>
+#include <vbk/pop_stats.hpp>
+#include <vbk/pop_submit.hpp>
 
 #include <vbk/test/util/e2e_fixture.hpp>
 
@@ -102,4 +104,119 @@ BOOST_FIXTURE_TEST_CASE(submitpop_test, E2eFixture)
     BOOST_CHECK_EQUAL(result["vbkblocks"].size(), vbk_blocks.size());
 }
 
+BOOST_FIXTURE_TEST_CASE(submitpop_async_test, E2eFixture)
+{
+    auto vtb = endorseVbkTip();
+
+    altintegration::WriteStream vtb_stream;
+    vtb.toVbkEncoding(vtb_stream);
+    UniValue vtb_params(UniValue::VARR);
+    vtb_params.push_back(HexStr(vtb_stream.data()));
+
+    altintegration::WriteStream vbk_stream;
+    vtb.containingBlock.toVbkEncoding(vbk_stream);
+    UniValue vbk_blocks_params(UniValue::VARR);
+    vbk_blocks_params.push_back(HexStr(vbk_stream.data()));
+
+    JSONRPCRequest request;
+    request.strMethod = "submitpop";
+    request.params = UniValue(UniValue::VARR);
+    request.params.push_back(vbk_blocks_params);
+    request.params.push_back(vtb_params);
+    request.params.push_back(UniValue(UniValue::VARR));
+    request.params.push_back(true);
+    request.fHelp = false;
+
+    if (RPCIsInWarmup(nullptr)) SetRPCWarmupFinished();
+
+    UniValue result;
+    BOOST_CHECK_NO_THROW(result = tableRPC.execute(request));
+    BOOST_REQUIRE_EQUAL(result["vtbs"].size(), 1);
+    BOOST_CHECK_EQUAL(result["vbkblocks"].size(), 1);
+    const std::string handle = result["vtbs"][0].get_str();
+    BOOST_CHECK_EQUAL(handle, HexStr(vtb.getId().asVector()));
+
+    JSONRPCRequest status;
+    status.strMethod = "getpopsubmitresult";
+    status.params = UniValue(UniValue::VARR);
+    status.params.push_back(handle);
+    status.fHelp = false;
+    BOOST_CHECK_EQUAL(tableRPC.execute(status)["status"].get_str(), "queued");
+    BOOST_CHECK_EQUAL(VeriBlock::getPopSubmitQueueStats().depth, 2);
+
+    // the submission thread is not running in tests
+    BOOST_CHECK(VeriBlock::processPopSubmissions());
+    BOOST_CHECK(!VeriBlock::processPopSubmissions());
+    BOOST_CHECK_EQUAL(tableRPC.execute(status)["status"].get_str(), "accepted");
+    BOOST_CHECK_EQUAL(VeriBlock::getPopSubmitQueueStats().depth, 0);
+    {
+        LOCK(VeriBlock::cs_popmempool);
+        BOOST_CHECK(VeriBlock::GetPop().mempool->getMap<VTB>().count(vtb.getId()));
+    }
+
+    status.params = UniValue(UniValue::VARR);
+    status.params.push_back("00");
+    BOOST_CHECK_THROW(tableRPC.execute(status), UniValue);
+}
+
+BOOST_FIXTURE_TEST_CASE(submitpop_async_duplicate_test, E2eFixture)
+{
+    auto vtb = endorseVbkTip();
+    altintegration::PopData popData;
+    popData.context.push_back(vtb.containingBlock);
+    popData.vtbs.push_back(vtb);
+
+    const auto before = VeriBlock::getPopSubmitQueueStats();
+    std::vector<std::string> handles;
+    BOOST_CHECK(VeriBlock::queuePopSubmission(popData, handles));
+    std::vector<std::string> duplicates;
+    BOOST_CHECK(VeriBlock::queuePopSubmission(popData, duplicates));
+
+    // pending payloads are queued once, and both submissions share handles
+    BOOST_CHECK(handles == duplicates);
+    BOOST_CHECK_EQUAL(VeriBlock::getPopSubmitQueueStats().depth, 2);
+
+    BOOST_CHECK(VeriBlock::processPopSubmissions());
+    BOOST_CHECK(!VeriBlock::processPopSubmissions());
+    auto stats = VeriBlock::getPopSubmitQueueStats();
+    BOOST_CHECK_EQUAL(stats.depth, 0);
+    BOOST_CHECK_EQUAL(stats.batches, before.batches + 1);
+    BOOST_CHECK_EQUAL(stats.accepted + stats.rejected, before.accepted + before.rejected + 2);
+    VeriBlock::PopSubmitResult result;
+    BOOST_REQUIRE(VeriBlock::getPopSubmitResult(handles[1], result));
+    BOOST_CHECK(result.status == VeriBlock::PopSubmitStatus::ACCEPTED);
+
+    // processed payloads can be submitted again under the same handles
+    duplicates.clear();
+    BOOST_CHECK(VeriBlock::queuePopSubmission(popData, duplicates));
+    BOOST_CHECK(handles == duplicates);
+    BOOST_REQUIRE(VeriBlock::getPopSubmitResult(handles[1], result));
+    BOOST_CHECK(result.status == VeriBlock::PopSubmitStatus::QUEUED);
+    BOOST_CHECK(VeriBlock::processPopSubmissions());
+    BOOST_REQUIRE(VeriBlock::getPopSubmitResult(handles[1], result));
+    BOOST_CHECK(result.status != VeriBlock::PopSubmitStatus::QUEUED);
+}
+
+BOOST_FIXTURE_TEST_CASE(pop_stats_are_recorded, TestChain100Setup)
+{
+    // TestChain100Setup connects blocks, which go through the alt tree
+    auto stats = VeriBlock::getPopStats();
+    BOOST_CHECK(stats[(size_t)VeriBlock::PopOperation::ACCEPT_BLOCK_HEADER].count >= 100u);
+
+    VeriBlock::resetPopStats();
+    VeriBlock::recordPopOperation(VeriBlock::PopOperation::MEMPOOL_SUBMIT, 50);
+    VeriBlock::recordPopOperation(VeriBlock::PopOperation::MEMPOOL_SUBMIT, 1000);
+    VeriBlock::recordPopOperation(VeriBlock::PopOperation::MEMPOOL_SUBMIT, 5000000);
+
+    stats = VeriBlock::getPopStats();
+    const auto& submit = stats[(size_t)VeriBlock::PopOperation::MEMPOOL_SUBMIT];
+    BOOST_CHECK_EQUAL(submit.count, 3u);
+    BOOST_CHECK_EQUAL(submit.totalMicros, 5001050);
+    BOOST_CHECK_EQUAL(submit.maxMicros, 5000000);
+    BOOST_CHECK_EQUAL(submit.histogram[0], 1u);
+    BOOST_CHECK_EQUAL(submit.histogram[1], 1u);
+    BOOST_CHECK_EQUAL(submit.histogram[VeriBlock::POP_STATS_BUCKETS - 1], 1u);
+    BOOST_CHECK_EQUAL(stats[(size_t)VeriBlock::PopOperation::ACCEPT_BLOCK_HEADER].count, 0u);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
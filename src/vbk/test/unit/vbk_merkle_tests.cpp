@@ -6,6 +6,7 @@
 
 #include <algorithm>
 
+#include <arith_uint256.h>
 #include <chain.h>
 #include <test/util/setup_common.h>
 #include <validation.h>
@@ -83,4 +84,36 @@ BOOST_FIXTURE_TEST_CASE(addPopTransactionRootIntoCoinbaseCommitment_test, Merkle
     BOOST_CHECK(!VeriBlock::VerifyTopLevelMerkleRoot(block, state, index->pprev));
 }
 
+// BasicTestingSetup selects regtest PoP config, where keystone interval is 5
+BOOST_FIXTURE_TEST_CASE(get_keystone_hashes_for_the_next_block, BasicTestingSetup)
+{
+    std::vector<uint256> hashes(1000);
+    std::vector<CBlockIndex> blocks(hashes.size());
+    for (size_t i = 0; i < blocks.size(); i++) {
+        hashes[i] = ArithToUint256(arith_uint256(i + 1));
+        blocks[i].phashBlock = &hashes[i];
+        blocks[i].pprev = i == 0 ? nullptr : &blocks[i - 1];
+        blocks[i].nHeight = i;
+        blocks[i].BuildSkip();
+    }
+
+    auto keystones = VeriBlock::getKeystoneHashesForTheNextBlock(nullptr);
+    BOOST_CHECK(keystones[0].IsNull() && keystones[1].IsNull());
+
+    keystones = VeriBlock::getKeystoneHashesForTheNextBlock(&blocks[4]);
+    BOOST_CHECK(keystones[0] == hashes[0]);
+    BOOST_CHECK(keystones[1].IsNull());
+
+    keystones = VeriBlock::getKeystoneHashesForTheNextBlock(&blocks[5]);
+    BOOST_CHECK(keystones[0] == hashes[5]);
+    BOOST_CHECK(keystones[1] == hashes[0]);
+
+    keystones = VeriBlock::getKeystoneHashesForTheNextBlock(&blocks[999]);
+    BOOST_CHECK(keystones[0] == hashes[995]);
+    BOOST_CHECK(keystones[1] == hashes[990]);
+
+    BOOST_CHECK(VeriBlock::getPreviousKeystone(blocks[995]) == &blocks[990]);
+    BOOST_CHECK(VeriBlock::getPreviousKeystone(blocks[999]) == &blocks[995]);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -9,7 +9,7 @@
  * network protocol versioning
  */
 
-static const int PROTOCOL_VERSION = 80000;
+static const int PROTOCOL_VERSION = 80001;
 
 //! initial proto version, to be increased after version/verack negotiation
 static const int INIT_PROTO_VERSION = 209;
@@ -45,4 +45,7 @@ static const int INVALID_CB_NO_BAN_VERSION = 70015;
 //! ping p2p msg contains 'best chain'
 static const int PING_BESTCHAIN_VERSION = 80000;
 
+//! compact blocks carry short ids of PoP payloads starting with this version
+static const int POP_SHORT_IDS_VERSION = 80001;
+
 #endif // BITCOIN_VERSION_H
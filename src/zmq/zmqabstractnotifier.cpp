@@ -20,3 +20,23 @@ bool CZMQAbstractNotifier::NotifyTransaction(const CTransaction &/*transaction*/
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifyATV(const altintegration::ATV &/*atv*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyVTB(const altintegration::VTB &/*vtb*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyVbkBlock(const altintegration::VbkBlock &/*block*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyPopTip(const CBlockIndex * /*pindex*/, const altintegration::VbkBlock &/*vbkTip*/, const altintegration::BtcBlock &/*btcTip*/)
+{
+    return true;
+}
@@ -7,6 +7,8 @@
 
 #include <zmq/zmqconfig.h>
 
+#include <veriblock/entities/popdata.hpp>
+
 class CBlockIndex;
 class CZMQAbstractNotifier;
 
@@ -42,6 +44,10 @@ public:
 
     virtual bool NotifyBlock(const CBlockIndex *pindex);
     virtual bool NotifyTransaction(const CTransaction &transaction);
+    virtual bool NotifyATV(const altintegration::ATV &atv);
+    virtual bool NotifyVTB(const altintegration::VTB &vtb);
+    virtual bool NotifyVbkBlock(const altintegration::VbkBlock &block);
+    virtual bool NotifyPopTip(const CBlockIndex *pindex, const altintegration::VbkBlock &vbkTip, const altintegration::BtcBlock &btcTip);
 
 protected:
     void *psocket;
@@ -46,6 +46,10 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
     factories["pubhashtx"] = CZMQAbstractNotifier::Create<CZMQPublishHashTransactionNotifier>;
     factories["pubrawblock"] = CZMQAbstractNotifier::Create<CZMQPublishRawBlockNotifier>;
     factories["pubrawtx"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionNotifier>;
+    factories["pubrawatv"] = CZMQAbstractNotifier::Create<CZMQPublishRawATVNotifier>;
+    factories["pubrawvtb"] = CZMQAbstractNotifier::Create<CZMQPublishRawVTBNotifier>;
+    factories["pubrawvbkblock"] = CZMQAbstractNotifier::Create<CZMQPublishRawVbkBlockNotifier>;
+    factories["pubpoptip"] = CZMQAbstractNotifier::Create<CZMQPublishPopTipNotifier>;
 
     for (const auto& entry : factories)
     {
@@ -193,4 +197,43 @@ void CZMQNotificationInterface::BlockDisconnected(const std::shared_ptr<const CB
     }
 }
 
+// Calls notify on every notifier, and drops the ones which failed
+template <typename Function>
+static void NotifyAll(std::list<CZMQAbstractNotifier*>& notifiers, Function notify)
+{
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    {
+        CZMQAbstractNotifier *notifier = *i;
+        if (notify(notifier))
+        {
+            i++;
+        }
+        else
+        {
+            notifier->Shutdown();
+            i = notifiers.erase(i);
+        }
+    }
+}
+
+void CZMQNotificationInterface::ATVAddedToPopMempool(const altintegration::ATV& atv)
+{
+    NotifyAll(notifiers, [&atv](CZMQAbstractNotifier* notifier) { return notifier->NotifyATV(atv); });
+}
+
+void CZMQNotificationInterface::VTBAddedToPopMempool(const altintegration::VTB& vtb)
+{
+    NotifyAll(notifiers, [&vtb](CZMQAbstractNotifier* notifier) { return notifier->NotifyVTB(vtb); });
+}
+
+void CZMQNotificationInterface::VbkBlockAddedToPopMempool(const altintegration::VbkBlock& block)
+{
+    NotifyAll(notifiers, [&block](CZMQAbstractNotifier* notifier) { return notifier->NotifyVbkBlock(block); });
+}
+
+void CZMQNotificationInterface::UpdatedPopTip(const CBlockIndex *pindexNew, const altintegration::VbkBlock& vbkTip, const altintegration::BtcBlock& btcTip)
+{
+    NotifyAll(notifiers, [&](CZMQAbstractNotifier* notifier) { return notifier->NotifyPopTip(pindexNew, vbkTip, btcTip); });
+}
+
 CZMQNotificationInterface* g_zmq_notification_interface = nullptr;
@@ -29,6 +29,10 @@ protected:
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected, const std::vector<CTransactionRef>& vtxConflicted) override;
     void BlockDisconnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexDisconnected) override;
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+    void ATVAddedToPopMempool(const altintegration::ATV& atv) override;
+    void VTBAddedToPopMempool(const altintegration::VTB& vtb) override;
+    void VbkBlockAddedToPopMempool(const altintegration::VbkBlock& block) override;
+    void UpdatedPopTip(const CBlockIndex *pindexNew, const altintegration::VbkBlock& vbkTip, const altintegration::BtcBlock& btcTip) override;
 
 private:
     CZMQNotificationInterface();
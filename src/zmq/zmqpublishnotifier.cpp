@@ -8,6 +8,7 @@
 #include <zmq/zmqpublishnotifier.h>
 #include <validation.h>
 #include <util/system.h>
+#include <util/strencodings.h>
 #include <rpc/server.h>
 
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
@@ -16,6 +17,10 @@ static const char *MSG_HASHBLOCK = "hashblock";
 static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
+static const char *MSG_RAWATV    = "rawatv";
+static const char *MSG_RAWVTB    = "rawvtb";
+static const char *MSG_RAWVBKBLOCK = "rawvbkblock";
+static const char *MSG_POPTIP    = "poptip";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -206,3 +211,47 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
     ss << transaction;
     return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
 }
+
+// PoP payloads are published in the same VBK encoding as submitpop accepts
+template <typename pop_t>
+static bool SendPopPayload(CZMQAbstractPublishNotifier& notifier, const char *command, const pop_t &payload)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish %s %s\n", command, HexStr(payload.getId().asVector()));
+    altintegration::WriteStream stream;
+    payload.toVbkEncoding(stream);
+    return notifier.SendMessage(command, stream.data().data(), stream.data().size());
+}
+
+bool CZMQPublishRawATVNotifier::NotifyATV(const altintegration::ATV &atv)
+{
+    return SendPopPayload(*this, MSG_RAWATV, atv);
+}
+
+bool CZMQPublishRawVTBNotifier::NotifyVTB(const altintegration::VTB &vtb)
+{
+    return SendPopPayload(*this, MSG_RAWVTB, vtb);
+}
+
+bool CZMQPublishRawVbkBlockNotifier::NotifyVbkBlock(const altintegration::VbkBlock &block)
+{
+    return SendPopPayload(*this, MSG_RAWVBKBLOCK, block);
+}
+
+bool CZMQPublishPopTipNotifier::NotifyPopTip(const CBlockIndex *pindex, const altintegration::VbkBlock &vbkTip, const altintegration::BtcBlock &btcTip)
+{
+    // block hash in the same order as hashblock, followed by VBK and BTC tip
+    // hashes in the same order as getvbkbestblockhash and getbtcbestblockhash
+    uint256 hash = pindex->GetBlockHash();
+    const auto vbkHash = vbkTip.getHash();
+    const auto btcHash = btcTip.getHash();
+    LogPrint(BCLog::ZMQ, "zmq: Publish poptip %s vbk %s btc %s\n", hash.GetHex(), vbkHash.toHex(), btcHash.toHex());
+
+    std::vector<unsigned char> data(32);
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = hash.begin()[i];
+    const auto vbkBytes = vbkHash.asVector();
+    const auto btcBytes = btcHash.asVector();
+    data.insert(data.end(), vbkBytes.begin(), vbkBytes.end());
+    data.insert(data.end(), btcBytes.begin(), btcBytes.end());
+    return SendMessage(MSG_POPTIP, data.data(), data.size());
+}
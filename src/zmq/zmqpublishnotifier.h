@@ -52,4 +52,28 @@ public:
     bool NotifyTransaction(const CTransaction &transaction) override;
 };
 
+class CZMQPublishRawATVNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyATV(const altintegration::ATV &atv) override;
+};
+
+class CZMQPublishRawVTBNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyVTB(const altintegration::VTB &vtb) override;
+};
+
+class CZMQPublishRawVbkBlockNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyVbkBlock(const altintegration::VbkBlock &block) override;
+};
+
+class CZMQPublishPopTipNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyPopTip(const CBlockIndex *pindex, const altintegration::VbkBlock &vbkTip, const altintegration::BtcBlock &btcTip) override;
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
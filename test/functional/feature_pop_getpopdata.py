@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019-2020 Xenios SEZC
+# https://www.veriblock.org
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+"""
+Test getpopdata and getpopdatarange, and that their cached results follow the active tip
+
+"""
+from test_framework.messages import CBlockHeader, FromHex
+from test_framework.pop import mine_vbk_blocks
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, assert_raises_rpc_error
+
+MAX_POP_DATA_RANGE = 1000
+
+
+class PopGetPopDataTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+        self.skip_if_no_pypopminer()
+
+    def block_hash(self, popdata):
+        header = FromHex(CBlockHeader(), popdata['block_header'])
+        header.rehash()
+        return header.hash
+
+    def _test_new_block(self):
+        self.log.info("running _test_new_block()")
+        node = self.nodes[0]
+
+        height = node.getblockcount()
+        before = node.getpopdata(height)
+        # the second call is served from cache
+        assert_equal(node.getpopdata(height), before)
+        assert_equal(self.block_hash(before), node.getbestblockhash())
+
+        # last known VBK blocks change once VBK blocks are mined
+        mine_vbk_blocks(node, self.apm, 3)
+        node.generate(nblocks=1)
+        after = node.getpopdata(height)
+        assert_equal(after['block_header'], before['block_header'])
+        assert after['last_known_veriblock_blocks'] != before['last_known_veriblock_blocks']
+
+        # a block replaced by a reorg is not served anymore
+        tip = node.getpopdata(height + 1)
+        node.invalidateblock(node.getbestblockhash())
+        node.generate(nblocks=1)
+        replaced = node.getpopdata(height + 1)
+        assert replaced['block_header'] != tip['block_header']
+        assert_equal(self.block_hash(replaced), node.getbestblockhash())
+
+        self.log.info("success! _test_new_block()")
+
+    def _test_range(self):
+        self.log.info("running _test_range()")
+        node = self.nodes[0]
+
+        last = node.getblockcount()
+        result = node.getpopdatarange(last - 4, last)
+        assert_equal(len(result), 5)
+        for i, popdata in enumerate(result):
+            assert_equal(popdata, node.getpopdata(last - 4 + i))
+        assert_equal(node.getpopdatarange(last, last), [node.getpopdata(last)])
+
+        # a new block invalidates cached heights of the range as well
+        node.generate(nblocks=1)
+        result = node.getpopdatarange(last - 4, last + 1)
+        assert_equal(len(result), 6)
+        assert_equal(self.block_hash(result[-1]), node.getbestblockhash())
+        assert_equal(result[-1], node.getpopdata(last + 1))
+
+        # range is limited to MAX_POP_DATA_RANGE heights, which are in the active chain
+        assert_raises_rpc_error(-8, "Range is limited to %d heights" % MAX_POP_DATA_RANGE, node.getpopdatarange, 0, MAX_POP_DATA_RANGE)
+        assert_raises_rpc_error(-8, "Block height out of range", node.getpopdatarange, 0, MAX_POP_DATA_RANGE - 1)
+        assert_raises_rpc_error(-8, "Invalid height range", node.getpopdatarange, 2, 1)
+        assert_raises_rpc_error(-8, "Invalid height range", node.getpopdatarange, -1, 1)
+        assert_raises_rpc_error(-8, "Block height out of range", node.getpopdata, node.getblockcount() + 1)
+
+        self.log.info("success! _test_range()")
+
+    def _test_restart(self):
+        self.log.info("running _test_restart()")
+        node = self.nodes[0]
+
+        height = node.getblockcount()
+        before = node.getpopdata(height)
+        self.restart_node(0)
+        # cache starts at the loaded tip
+        assert_equal(node.getpopdata(height), before)
+        assert_equal(node.getpopdata(height), before)
+        node.generate(nblocks=1)
+        assert_equal(self.block_hash(node.getpopdata(height + 1)), node.getbestblockhash())
+
+        self.log.info("success! _test_restart()")
+
+    def run_test(self):
+        """Main test logic"""
+
+        self.nodes[0].generate(nblocks=10)
+
+        from pypopminer import MockMiner
+        self.apm = MockMiner()
+
+        self._test_new_block()
+        self._test_range()
+        self._test_restart()
+
+
+if __name__ == '__main__':
+    PopGetPopDataTest().main()
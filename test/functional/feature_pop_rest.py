@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+# Copyright (c) 2014-2019 The Bitcoin Core developers
+# Copyright (c) 2019-2020 Xenios SEZC
+# https://www.veriblock.org
+# Distributed under the MIT software license, see the accompanying
+# file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+
+"""
+Test the PoP REST endpoints: /vbkblock, /btcblock, /vbkheaders, /popmempool and /payload
+
+"""
+from decimal import Decimal
+from io import BytesIO
+import http.client
+import json
+import urllib.parse
+
+from test_framework.messages import deser_string
+from test_framework.pop import endorse_block, mine_vbk_blocks
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+
+
+def deser_all(data):
+    """Read length prefixed entries, as they are written by the .bin replies"""
+    f = BytesIO(data)
+    entries = []
+    while f.tell() < len(data):
+        entries.append(deser_string(f))
+    return entries
+
+
+class PopRestTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+        self.extra_args = [["-rest"]]
+        self.supports_cli = False
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+        self.skip_if_no_pypopminer()
+
+    def rest_request(self, uri, ext='json', status=200):
+        conn = http.client.HTTPConnection(self.url.hostname, self.url.port)
+        rest_uri = '/rest' + uri + ('.' + ext if ext else '')
+        self.log.debug('GET %s', rest_uri)
+        conn.request('GET', rest_uri)
+        resp = conn.getresponse()
+        assert_equal(resp.status, status)
+        return resp.read()
+
+    def rest_formats(self, uri):
+        """Request uri in every format, check that .hex matches .bin and return (.bin, .json)"""
+        data = self.rest_request(uri, 'bin')
+        assert_equal(self.rest_request(uri, 'hex').decode('ascii').strip(), data.hex())
+        obj = json.loads(self.rest_request(uri, 'json').decode('utf-8'), parse_float=Decimal)
+        # a request without a format is not found
+        self.rest_request(uri, '', status=404)
+        return data, obj
+
+    def _test_blocks(self):
+        self.log.info("running _test_blocks()")
+        node = self.nodes[0]
+
+        for chain, hash_size in [('vbk', 24), ('btc', 32)]:
+            tip = getattr(node, 'get%sbestblockhash' % chain)()
+            data, obj = self.rest_formats('/%sblock/%s' % (chain, tip))
+            assert_equal(obj, getattr(node, 'get%sblock' % chain)(tip))
+            assert_equal(len(deser_all(data)), 1)
+
+            self.rest_request('/%sblock/%s' % (chain, '00' * hash_size), status=404)
+            self.rest_request('/%sblock/%s' % (chain, 'zz' * hash_size), status=400)
+
+        self.log.info("success! _test_blocks()")
+
+    def _test_vbkheaders(self):
+        self.log.info("running _test_vbkheaders()")
+        node = self.nodes[0]
+
+        first = node.getvbkbestblockhash()
+        mine_vbk_blocks(node, self.apm, 3)
+        vbk_ids = node.getrawpopmempool()['vbkblocks']
+        assert_equal(len(vbk_ids), 3)
+        node.generate(nblocks=1)
+
+        # headers of the best VBK chain, starting at first
+        data, obj = self.rest_formats('/vbkheaders/10/%s' % first)
+        assert_equal(len(obj), 4)
+        headers = deser_all(data)
+        assert_equal(len(headers), 4)
+        mined = {deser_all(self.rest_request('/payload/vbkblock/%s' % vbk_id, 'bin'))[0] for vbk_id in vbk_ids}
+        assert_equal(set(headers[1:]), mined)
+
+        data, obj = self.rest_formats('/vbkheaders/2/%s' % first)
+        assert_equal(len(obj), 2)
+        assert_equal(deser_all(data), headers[:2])
+
+        # count is limited to [1, 2000]
+        self.rest_request('/vbkheaders/1/%s' % first)
+        self.rest_request('/vbkheaders/2000/%s' % first)
+        self.rest_request('/vbkheaders/0/%s' % first, status=400)
+        self.rest_request('/vbkheaders/2001/%s' % first, status=400)
+        self.rest_request('/vbkheaders/-1/%s' % first, status=400)
+        self.rest_request('/vbkheaders/abc/%s' % first, status=400)
+        self.rest_request('/vbkheaders/%s' % first, status=400)
+        self.rest_request('/vbkheaders/1/%s' % ('zz' * 24), status=400)
+
+        # there are no headers for an unknown hash
+        assert_equal(json.loads(self.rest_request('/vbkheaders/1/%s' % ('00' * 24))), [])
+
+        self.log.info("success! _test_vbkheaders()")
+
+    def _test_popmempool_and_payloads(self):
+        self.log.info("running _test_popmempool_and_payloads()")
+        node = self.nodes[0]
+
+        data, obj = self.rest_formats('/popmempool')
+        assert_equal(obj, node.getrawpopmempool())
+
+        addr = node.getnewaddress()
+        atv_id = endorse_block(node, self.apm, node.getblockcount() - 5, addr, vtbs=1)
+        mempool = node.getrawpopmempool()
+        assert_equal(len(mempool['vtbs']), 1)
+
+        data, obj = self.rest_formats('/popmempool')
+        assert_equal(obj, mempool)
+        # .bin is PopData with all payloads, as it is encoded in a block
+        assert_equal(len(deser_all(data)), 1)
+
+        payloads = [('atv', atv_id, node.getrawatv), ('vtb', mempool['vtbs'][0], node.getrawvtb)]
+        payloads += [('vbkblock', vbk_id, node.getrawvbkblock) for vbk_id in mempool['vbkblocks']]
+        for name, payload_id, getraw in payloads:
+            data, obj = self.rest_formats('/payload/%s/%s' % (name, payload_id))
+            assert_equal(deser_all(data), [bytes.fromhex(getraw(payload_id))])
+            assert_equal(obj, getraw(payload_id, True)[name])
+
+        # payloads are still found after they are mined
+        containing = node.generate(nblocks=1)[0]
+        assert atv_id in node.getblock(containing)['pop']['data']['atvs']
+        data, _ = self.rest_formats('/payload/atv/%s' % atv_id)
+        assert_equal(deser_all(data), [bytes.fromhex(node.getrawatv(atv_id))])
+        assert_equal(json.loads(self.rest_request('/popmempool')), node.getrawpopmempool())
+
+        self.rest_request('/payload/atv/%s' % ('00' * 32), status=404)
+        self.rest_request('/payload/vtb/%s' % ('00' * 32), status=404)
+        self.rest_request('/payload/vbkblock/%s' % ('00' * 12), status=404)
+        self.rest_request('/payload/atv/%s' % ('zz' * 32), status=400)
+        self.rest_request('/payload/tx/%s' % atv_id, status=400)
+        self.rest_request('/payload/%s' % atv_id, status=400)
+
+        self.log.info("success! _test_popmempool_and_payloads()")
+
+    def run_test(self):
+        """Main test logic"""
+
+        self.url = urllib.parse.urlparse(self.nodes[0].url)
+        self.nodes[0].generate(nblocks=10)
+
+        from pypopminer import MockMiner
+        self.apm = MockMiner()
+
+        self._test_blocks()
+        self._test_vbkheaders()
+        self._test_popmempool_and_payloads()
+
+
+if __name__ == '__main__':
+    PopRestTest().main()
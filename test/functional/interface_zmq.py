@@ -8,7 +8,8 @@ import struct
 from test_framework.address import ADDRESS_BCRT1_UNSPENDABLE
 from test_framework.test_framework import BitcoinTestFramework
 from test_framework.messages import CTransaction, hash256
-from test_framework.util import assert_equal, connect_nodes
+from test_framework.pop import endorse_block, mine_vbk_blocks
+from test_framework.util import assert_equal, assert_raises, connect_nodes
 from io import BytesIO
 from time import sleep
 
@@ -48,6 +49,8 @@ class ZMQTest (BitcoinTestFramework):
         try:
             self.test_basic()
             self.test_reorg()
+            if self.is_wallet_compiled() and self.is_pypopminer_available():
+                self.test_pop()
         finally:
             # Destroy the ZMQ context.
             self.log.debug("Destroying ZMQ context")
@@ -152,5 +155,86 @@ class ZMQTest (BitcoinTestFramework):
         # Should receive nodes[1] tip
         assert_equal(self.nodes[1].getbestblockhash(), hashblock.receive().hex())
 
+    def is_pypopminer_available(self):
+        try:
+            import pypopminer  # noqa
+        except ImportError:
+            self.log.info("pypopminer module not available, skipping PoP notifications")
+            return False
+        return True
+
+    def test_pop(self):
+        import zmq
+        from pypopminer import MockMiner
+        apm = MockMiner()
+        address = 'tcp://127.0.0.1:28334'
+
+        # One socket per topic, PoP payloads of different types may be
+        # published in any order
+        subs = {}
+        for topic in [b'rawatv', b'rawvtb', b'rawvbkblock', b'poptip']:
+            socket = self.ctx.socket(zmq.SUB)
+            socket.set(zmq.RCVTIMEO, 60000)
+            subs[topic] = ZMQSubscriber(socket, topic)
+        rawatv, rawvtb, rawvbkblock, poptip = subs.values()
+
+        self.restart_node(0, ['-zmqpub%s=%s' % (sub.topic.decode(), address) for sub in subs.values()])
+        for sub in subs.values():
+            sub.socket.connect(address)
+        # Relax so that the subscriber is ready before publishing zmq messages
+        sleep(0.2)
+
+        node = self.nodes[0]
+        addr = node.getnewaddress()
+
+        def check_poptip():
+            body = poptip.receive()
+            assert_equal(len(body), 32 + 24 + 32)
+            assert_equal(body[:32].hex(), node.getbestblockhash())
+            assert_equal(body[32:56].hex(), node.getvbkbestblockhash())
+            assert_equal(body[56:].hex(), node.getbtcbestblockhash())
+
+        self.log.info("Should publish poptip when the tip changes")
+        node.generatetoaddress(1, addr)
+        check_poptip()
+
+        self.log.info("Should publish raw VBK blocks accepted by submitpop")
+        mine_vbk_blocks(node, apm, 2)
+        node.syncwithvalidationinterfacequeue()
+        vbkblocks = node.getrawpopmempool()['vbkblocks']
+        assert_equal(len(vbkblocks), 2)
+        published = {rawvbkblock.receive().hex() for _ in vbkblocks}
+        assert_equal(published, {node.getrawvbkblock(vbk_id) for vbk_id in vbkblocks})
+
+        self.log.info("Should publish raw ATVs and VTBs accepted by submitpop")
+        atv_id = endorse_block(node, apm, node.getblockcount(), addr, vtbs=1)
+        node.syncwithvalidationinterfacequeue()
+        assert_equal(rawatv.receive().hex(), node.getrawatv(atv_id))
+        mempool = node.getrawpopmempool()
+        assert_equal(len(mempool['vtbs']), 1)
+        assert_equal(rawvtb.receive().hex(), node.getrawvtb(mempool['vtbs'][0]))
+        # VBK blocks submitted with the endorsement
+        context = set(mempool['vbkblocks']) - set(vbkblocks)
+        published = {rawvbkblock.receive().hex() for _ in context}
+        assert_equal(published, {node.getrawvbkblock(vbk_id) for vbk_id in context})
+
+        self.log.info("Should publish poptip with the new PoP tips after mining the payloads")
+        containing = node.generatetoaddress(1, addr)[0]
+        assert atv_id in node.getblock(containing)['pop']['data']['atvs']
+        check_poptip()
+
+        # Mining does not publish the payloads again
+        node.syncwithvalidationinterfacequeue()
+        for sub in [rawatv, rawvtb, rawvbkblock]:
+            assert_raises(zmq.Again, sub.socket.recv_multipart, zmq.NOBLOCK)
+
+        assert_equal(node.getzmqnotifications(), [
+            {"type": "pubpoptip", "address": address, "hwm": 1000},
+            {"type": "pubrawatv", "address": address, "hwm": 1000},
+            {"type": "pubrawvbkblock", "address": address, "hwm": 1000},
+            {"type": "pubrawvtb", "address": address, "hwm": 1000},
+        ])
+
+
 if __name__ == '__main__':
     ZMQTest().main()
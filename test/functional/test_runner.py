@@ -125,6 +125,8 @@ BASE_SCRIPTS = [
     'feature_pop_mempool_reorg.py',
     'feature_pop_mempool_getpop.py',
     'feature_pop_e2e.py',
+    'feature_pop_rest.py',
+    'feature_pop_getpopdata.py',
     ## end VeriBlock tests
     'wallet_keypool_topup.py',
     'feature_fee_estimation.py',